@@ -0,0 +1,355 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <math.h>
+#include <new>
+#include <memory_resource>
+#include <random>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "alloc_trace_format.h"
+
+struct AllocTrace
+{
+    uint32_t threadCount = 0;
+    std::vector<AllocTraceRecord> records;
+};
+
+inline bool LoadAllocTrace(const char* path, AllocTrace& trace)
+{
+    FILE* fp = fopen(path, "rb");
+    if (!fp)
+        return false;
+
+    AllocTraceHeader header;
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1
+        && memcmp(header.magic, ALLOC_TRACE_MAGIC, 4) == 0
+        && header.version == ALLOC_TRACE_VERSION;
+    // The record count must fit in the rest of the file before anything is allocated for it.
+    long dataStart = ok ? ftell(fp) : -1;
+    ok = ok && dataStart >= 0 && fseek(fp, 0, SEEK_END) == 0;
+    long fileSize = ok ? ftell(fp) : -1;
+    ok = ok && fileSize >= dataStart && fseek(fp, dataStart, SEEK_SET) == 0
+        && header.recordCount <= (uint64_t)(fileSize - dataStart) / sizeof(AllocTraceRecord);
+    if (ok)
+    {
+        trace.threadCount = header.threadCount;
+        trace.records.resize(header.recordCount);
+        ok = fread(trace.records.data(), sizeof(AllocTraceRecord), trace.records.size(), fp) == trace.records.size();
+    }
+    fclose(fp);
+    return ok;
+}
+
+inline bool SaveAllocTrace(const char* path, const AllocTrace& trace)
+{
+    FILE* fp = fopen(path, "wb");
+    if (!fp)
+        return false;
+
+    AllocTraceHeader header;
+    memcpy(header.magic, ALLOC_TRACE_MAGIC, 4);
+    header.version = ALLOC_TRACE_VERSION;
+    header.recordCount = trace.records.size();
+    header.threadCount = trace.threadCount;
+    header.reserved = 0;
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+        && fwrite(trace.records.data(), sizeof(AllocTraceRecord), trace.records.size(), fp) == trace.records.size();
+    return fclose(fp) == 0 && ok;
+}
+
+// Service-like synthetic workload: mostly small objects with short lives,
+// a tail of medium and large buffers, a few long-lived and leaked objects,
+// and `crossThreadFraction` of frees done by a different thread.
+inline AllocTrace GenerateAllocTrace(size_t recordCount, uint32_t threadCount, double crossThreadFraction, uint32_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::exponential_distribution<double> shortLife(1.0 / 1000.0);
+    std::exponential_distribution<double> longLife(1.0 / 100000.0);
+    std::uniform_int_distribution<uint32_t> pickThread(0, threadCount - 1);
+
+    auto logUniform = [&](double lo, double hi) { return (uint32_t)(lo * pow(hi / lo, unit(rng))); };
+
+    AllocTrace trace;
+    trace.threadCount = threadCount;
+    trace.records.resize(recordCount);
+    for (AllocTraceRecord& r : trace.records)
+    {
+        double kind = unit(rng);
+        r.size = kind < 0.80 ? logUniform(16, 512) : kind < 0.98 ? logUniform(512, 64 * 1024) : logUniform(64 * 1024, 1024 * 1024);
+
+        double fate = unit(rng);
+        r.lifetime = fate < 0.001 ? ALLOC_TRACE_NEVER_FREED : (uint32_t)(fate < 0.05 ? longLife(rng) : shortLife(rng));
+
+        r.thread = (uint16_t)pickThread(rng);
+        r.freeThread = r.thread;
+        if (threadCount > 1 && unit(rng) < crossThreadFraction)
+            r.freeThread = (uint16_t)((r.thread + 1 + pickThread(rng) % (threadCount - 1)) % threadCount);
+    }
+    return trace;
+}
+
+// Allocator under test. Implementations must be thread-safe and accept frees
+// from a thread other than the one that allocated.
+class AllocatorBackend
+{
+public:
+    virtual ~AllocatorBackend() = default;
+    virtual const char* Name() const = 0;
+    virtual void* Allocate(size_t size) = 0;
+    virtual void Free(void* p, size_t size) = 0;
+};
+
+class MallocBackend : public AllocatorBackend
+{
+public:
+    const char* Name() const override { return "malloc"; }
+    void* Allocate(size_t size) override { return malloc(size); }
+    void Free(void* p, size_t) override { free(p); }
+};
+
+class NewDeleteBackend : public AllocatorBackend
+{
+public:
+    const char* Name() const override { return "new/delete"; }
+    void* Allocate(size_t size) override { return ::operator new(size); }
+    void Free(void* p, size_t size) override { ::operator delete(p, size); }
+};
+
+class PmrPoolBackend : public AllocatorBackend
+{
+public:
+    const char* Name() const override { return "pmr pool"; }
+    void* Allocate(size_t size) override { return pool.allocate(size); }
+    void Free(void* p, size_t size) override { pool.deallocate(p, size); }
+private:
+    std::pmr::synchronized_pool_resource pool;
+};
+
+inline size_t ResidentBytes()
+{
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (!fp)
+        return 0;
+    unsigned long total = 0, resident = 0;
+    if (fscanf(fp, "%lu %lu", &total, &resident) != 2)
+        resident = 0;
+    fclose(fp);
+    return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+// Largest sum of live requested bytes over the trace, replayed in global order.
+inline size_t PeakLiveBytes(const AllocTrace& trace)
+{
+    std::vector<std::pair<uint64_t, uint32_t>> frees; // (free position, size)
+    for (size_t i = 0; i < trace.records.size(); ++i)
+    {
+        if (trace.records[i].lifetime != ALLOC_TRACE_NEVER_FREED)
+            frees.emplace_back(i + trace.records[i].lifetime, trace.records[i].size);
+    }
+    std::sort(frees.begin(), frees.end());
+
+    size_t live = 0, peak = 0, next = 0;
+    for (size_t i = 0; i < trace.records.size(); ++i)
+    {
+        for (; next < frees.size() && frees[next].first < i; ++next)
+            live -= frees[next].second;
+        live += trace.records[i].size;
+        peak = std::max(peak, live);
+    }
+    return peak;
+}
+
+struct ReplayResult
+{
+    double seconds = 0.0;
+    uint64_t operations = 0;
+    size_t peakRss = 0;
+    size_t baselineRss = 0;
+    uint32_t failedSize = 0; // size of the allocation the backend could not satisfy, 0 on success
+};
+
+// Replays `trace` on `threadCount` threads. Trace thread t allocates on
+// replay thread t % threadCount and the same mapping is used for frees, so
+// cross-thread frees stay cross-thread whenever threadCount > 1. A free
+// waits until the owning allocation has happened; allocations and frees are
+// ordered by global trace position, so the waits cannot form a cycle.
+// If the backend fails an allocation the replay stops on every thread and
+// `failedSize` reports the request.
+inline ReplayResult ReplayAllocTrace(const AllocTrace& trace, uint32_t threadCount, AllocatorBackend& backend)
+{
+    struct Op { uint64_t position; uint32_t record; bool isFree; };
+
+    const size_t n = trace.records.size();
+    std::vector<std::vector<Op>> ops(threadCount);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const AllocTraceRecord& r = trace.records[i];
+        // Position 2*i is the allocation, 2*(i + lifetime) + 1 sits right after
+        // the last allocation the object lived through.
+        ops[r.thread % threadCount].push_back({ 2 * (uint64_t)i, (uint32_t)i, false });
+        if (r.lifetime != ALLOC_TRACE_NEVER_FREED)
+            ops[r.freeThread % threadCount].push_back({ 2 * ((uint64_t)i + r.lifetime) + 1, (uint32_t)i, true });
+    }
+    for (auto& list : ops)
+        std::sort(list.begin(), list.end(), [](const Op& a, const Op& b) { return a.position < b.position; });
+
+    std::vector<std::atomic<void*>> slots(n);
+    for (auto& slot : slots)
+        slot.store(nullptr, std::memory_order_relaxed);
+
+    ReplayResult result;
+    result.baselineRss = ResidentBytes();
+
+    std::atomic<bool> sampling{ true };
+    std::atomic<size_t> peakRss{ result.baselineRss };
+    std::thread sampler([&]
+    {
+        while (sampling.load(std::memory_order_relaxed))
+        {
+            peakRss.store(std::max(peakRss.load(), ResidentBytes()));
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    std::atomic<uint32_t> ready{ 0 };
+    std::atomic<bool> go{ false };
+    std::atomic<uint32_t> failedSize{ 0 };
+    std::vector<std::thread> workers;
+    for (uint32_t t = 0; t < threadCount; ++t)
+    {
+        workers.emplace_back([&, t]
+        {
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+
+            for (const Op& op : ops[t])
+            {
+                const AllocTraceRecord& r = trace.records[op.record];
+                if (!op.isFree)
+                {
+                    char* p = nullptr;
+                    try
+                    {
+                        p = (char*)backend.Allocate(r.size);
+                    }
+                    catch (const std::bad_alloc&)
+                    {
+                    }
+                    if (!p)
+                    {
+                        failedSize.store(std::max(r.size, 1u));
+                        return;
+                    }
+                    // Touch each page so resident memory reflects the allocation.
+                    for (size_t offset = 0; offset < r.size; offset += 4096)
+                        p[offset] = 1;
+                    slots[op.record].store(p, std::memory_order_release);
+                }
+                else
+                {
+                    void* p;
+                    while (!(p = slots[op.record].load(std::memory_order_acquire)))
+                    {
+                        if (failedSize.load(std::memory_order_relaxed))
+                            return;
+                        std::this_thread::yield();
+                    }
+                    backend.Free(p, r.size);
+                    slots[op.record].store(nullptr, std::memory_order_relaxed);
+                }
+            }
+        });
+    }
+
+    while (ready.load() != threadCount)
+        std::this_thread::yield();
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& w : workers)
+        w.join();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    sampling.store(false);
+    sampler.join();
+    result.peakRss = std::max(peakRss.load(), ResidentBytes());
+    result.failedSize = failedSize.load();
+
+    for (auto& list : ops)
+        result.operations += list.size();
+
+    // Objects the trace never freed (or that a failed replay left behind) are
+    // released outside the timed region.
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (void* p = slots[i].load())
+            backend.Free(p, trace.records[i].size);
+    }
+    return result;
+}
+
+inline void MeasureAllocTrace(const AllocTrace& trace, uint32_t threadCount)
+{
+    size_t crossThread = 0;
+    for (const AllocTraceRecord& r : trace.records)
+        crossThread += r.lifetime != ALLOC_TRACE_NEVER_FREED && r.thread % threadCount != r.freeThread % threadCount;
+    size_t peakLive = PeakLiveBytes(trace);
+
+    printf("Replaying %zu allocations from %u trace threads on %u threads (%zu cross-thread frees, peak live %.1f MB)...\n",
+        trace.records.size(), trace.threadCount, threadCount, crossThread, peakLive / (1024.0 * 1024.0));
+
+    MallocBackend mallocBackend;
+    NewDeleteBackend newDeleteBackend;
+    PmrPoolBackend pmrPoolBackend;
+    AllocatorBackend* backends[] = { &mallocBackend, &newDeleteBackend, &pmrPoolBackend };
+
+    for (AllocatorBackend* backend : backends)
+    {
+        // Each backend runs in a fresh child so memory retained by the previous
+        // one does not hide in the RSS baseline.
+        int fds[2];
+        if (pipe(fds) != 0)
+            return;
+        pid_t child = fork();
+        if (child == 0)
+        {
+            close(fds[0]);
+            ReplayResult r = ReplayAllocTrace(trace, threadCount, *backend);
+            ssize_t written = write(fds[1], &r, sizeof(r));
+            _exit(written == (ssize_t)sizeof(r) ? 0 : 1);
+        }
+        close(fds[1]);
+        ReplayResult r;
+        bool ok = child > 0 && read(fds[0], &r, sizeof(r)) == (ssize_t)sizeof(r);
+        close(fds[0]);
+        if (child > 0)
+            waitpid(child, nullptr, 0);
+        if (!ok)
+        {
+            printf("%-10s replay failed\n", backend->Name());
+            continue;
+        }
+        if (r.failedSize)
+        {
+            printf("%-10s replay aborted: allocation of %u bytes failed\n", backend->Name(), r.failedSize);
+            continue;
+        }
+
+        double rssGrowth = r.peakRss > r.baselineRss ? (double)(r.peakRss - r.baselineRss) : 0.0;
+        printf("%-10s %1.4f s, %.2f Mops/s, peak RSS %.1f MB (+%.1f MB), fragmentation %.2fx\n",
+            backend->Name(), r.seconds, r.operations / r.seconds * 1e-6,
+            r.peakRss / (1024.0 * 1024.0), rssGrowth / (1024.0 * 1024.0),
+            peakLive ? rssGrowth / peakLive : 0.0);
+    }
+}
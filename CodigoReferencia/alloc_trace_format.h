@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+// On-disk allocation trace: an AllocTraceHeader followed by `recordCount`
+// AllocTraceRecords, one per allocation, in the order the allocations were
+// made. Shared by the replay harness and the LD_PRELOAD recorder, so it only
+// depends on <stdint.h>.
+
+#define ALLOC_TRACE_MAGIC "ATRC"
+#define ALLOC_TRACE_VERSION 1
+
+// Lifetime of an allocation that was never freed while recording.
+#define ALLOC_TRACE_NEVER_FREED 0xFFFFFFFFu
+
+#pragma pack(push, 1)
+struct AllocTraceHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t recordCount;
+    uint32_t threadCount;
+    uint32_t reserved;
+};
+
+struct AllocTraceRecord
+{
+    uint32_t size;       // requested bytes
+    uint32_t lifetime;   // allocations made between this one and its free
+    uint16_t thread;     // thread that allocated
+    uint16_t freeThread; // thread that freed (differs for cross-thread frees)
+};
+#pragma pack(pop)
@@ -0,0 +1,267 @@
+// LD_PRELOAD recorder producing traces for the replay benchmark.
+//
+//   g++ -std=c++17 -O2 -shared -fPIC alloc_trace_shim.cpp -o alloc_trace_shim.so
+//   ALLOC_TRACE_FILE=app.trace LD_PRELOAD=./alloc_trace_shim.so ./app
+//
+// Interposes malloc/calloc/realloc/free/posix_memalign/aligned_alloc and
+// forwards to glibc's __libc_* entry points, so it never has to call dlsym
+// (which itself allocates). Bookkeeping lives in mmap'd memory sized by
+// ALLOC_TRACE_MAX_RECORDS (default 4M); allocations past that are forwarded
+// but not recorded. The trace is written when the process exits.
+
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "alloc_trace_format.h"
+
+extern "C"
+{
+void* __libc_malloc(size_t);
+void* __libc_calloc(size_t, size_t);
+void* __libc_realloc(void*, size_t);
+void* __libc_memalign(size_t, size_t);
+void __libc_free(void*);
+}
+
+namespace
+{
+
+struct Slot
+{
+    uintptr_t ptr;  // 0: empty, 1: tombstone
+    uint64_t index;
+};
+
+const uintptr_t Tombstone = 1;
+
+AllocTraceRecord* records;
+Slot* table;
+uint64_t maxRecords;
+uint64_t tableMask;
+std::atomic<uint64_t> recordCount{0};
+std::atomic<uint16_t> threadCount{0};
+std::atomic_flag tableLock = ATOMIC_FLAG_INIT;
+bool ready;
+
+__thread int threadId __attribute__((tls_model("initial-exec"))) = -1;
+
+uint16_t ThisThread()
+{
+    if (threadId < 0)
+        threadId = threadCount.fetch_add(1);
+    return (uint16_t)threadId;
+}
+
+uint64_t Hash(uintptr_t p)
+{
+    return (p >> 4) * 0x9E3779B97F4A7C15ull;
+}
+
+void Lock()
+{
+    while (tableLock.test_and_set(std::memory_order_acquire))
+        ;
+}
+
+void Unlock()
+{
+    tableLock.clear(std::memory_order_release);
+}
+
+const uint64_t NoRecord = UINT64_MAX;
+
+void Attach(void* p, uint64_t index)
+{
+    Lock();
+    for (uint64_t h = Hash((uintptr_t)p) & tableMask;; h = (h + 1) & tableMask)
+    {
+        if (table[h].ptr <= Tombstone)
+        {
+            table[h].ptr = (uintptr_t)p;
+            table[h].index = index;
+            break;
+        }
+    }
+    Unlock();
+}
+
+// Removes `p` from the table and returns its record, or NoRecord if it is not tracked.
+uint64_t Detach(void* p)
+{
+    uint64_t index = NoRecord;
+    Lock();
+    for (uint64_t h = Hash((uintptr_t)p) & tableMask; table[h].ptr != 0; h = (h + 1) & tableMask)
+    {
+        if (table[h].ptr == (uintptr_t)p)
+        {
+            index = table[h].index;
+            table[h].ptr = Tombstone;
+            break;
+        }
+    }
+    Unlock();
+    return index;
+}
+
+// Records the free of a record already detached from the table.
+void Close(uint64_t index)
+{
+    uint64_t now = recordCount.load();
+    AllocTraceRecord& r = records[index];
+    uint64_t lifetime = now - index - 1;
+    r.lifetime = lifetime >= ALLOC_TRACE_NEVER_FREED ? ALLOC_TRACE_NEVER_FREED - 1 : (uint32_t)lifetime;
+    r.freeThread = ThisThread();
+}
+
+void OnAlloc(void* p, size_t size)
+{
+    if (!ready || !p)
+        return;
+    uint64_t index = recordCount.fetch_add(1);
+    if (index >= maxRecords)
+        return;
+
+    AllocTraceRecord& r = records[index];
+    r.size = size > UINT32_MAX ? UINT32_MAX : (uint32_t)size;
+    r.lifetime = ALLOC_TRACE_NEVER_FREED;
+    r.thread = r.freeThread = ThisThread();
+    Attach(p, index);
+}
+
+void OnFree(void* p)
+{
+    if (!ready || !p)
+        return;
+    uint64_t index = Detach(p);
+    if (index != NoRecord)
+        Close(index);
+}
+
+__attribute__((constructor)) void Start()
+{
+    const char* env = getenv("ALLOC_TRACE_MAX_RECORDS");
+    maxRecords = env ? strtoull(env, nullptr, 10) : (4ull << 20);
+
+    uint64_t tableSize = 1;
+    while (tableSize < maxRecords * 2)
+        tableSize <<= 1;
+    tableMask = tableSize - 1;
+
+    void* r = mmap(nullptr, maxRecords * sizeof(AllocTraceRecord), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    void* t = mmap(nullptr, tableSize * sizeof(Slot), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (r == MAP_FAILED || t == MAP_FAILED)
+        return;
+
+    records = (AllocTraceRecord*)r;
+    table = (Slot*)t;
+    ready = true;
+}
+
+__attribute__((destructor)) void Finish()
+{
+    if (!ready)
+        return;
+    ready = false;
+
+    const char* path = getenv("ALLOC_TRACE_FILE");
+    int fd = open(path ? path : "alloc.trace", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return;
+
+    uint64_t count = recordCount.load();
+    if (count > maxRecords)
+        count = maxRecords;
+
+    AllocTraceHeader header;
+    memcpy(header.magic, ALLOC_TRACE_MAGIC, 4);
+    header.version = ALLOC_TRACE_VERSION;
+    header.recordCount = count;
+    header.threadCount = threadCount.load();
+    header.reserved = 0;
+
+    const char* data[2] = { (const char*)&header, (const char*)records };
+    size_t length[2] = { sizeof(header), count * sizeof(AllocTraceRecord) };
+    for (int i = 0; i < 2; ++i)
+    {
+        while (length[i] > 0)
+        {
+            ssize_t n = write(fd, data[i], length[i]);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            data[i] += n;
+            length[i] -= (size_t)n;
+        }
+    }
+    close(fd);
+}
+
+} // namespace
+
+extern "C"
+{
+
+void* malloc(size_t size)
+{
+    void* p = __libc_malloc(size);
+    OnAlloc(p, size);
+    return p;
+}
+
+void* calloc(size_t n, size_t size)
+{
+    void* p = __libc_calloc(n, size);
+    OnAlloc(p, n * size);
+    return p;
+}
+
+void* realloc(void* old, size_t size)
+{
+    // `old` leaves the table before libc can hand it to another thread; a
+    // failed realloc leaves the block allocated, so its entry goes back.
+    uint64_t index = ready && old ? Detach(old) : NoRecord;
+    void* p = __libc_realloc(old, size);
+    if (p || size == 0)
+    {
+        if (index != NoRecord)
+            Close(index);
+        OnAlloc(p, size);
+    }
+    else if (index != NoRecord)
+        Attach(old, index);
+    return p;
+}
+
+void free(void* p)
+{
+    OnFree(p);
+    __libc_free(p);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size)
+{
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+    void* p = __libc_memalign(alignment, size);
+    if (!p)
+        return ENOMEM;
+    OnAlloc(p, size);
+    *out = p;
+    return 0;
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    void* p = __libc_memalign(alignment, size);
+    OnAlloc(p, size);
+    return p;
+}
+
+} // extern "C"
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/utsname.h>
+#include <utility>
+#include <vector>
+
+// Per-phase timings collected over repeated runs, saved with host metadata
+// so later runs can be compared against them.
+//
+// File format (text, one item per line):
+//   memory-benchmark-results 1
+//   meta <key> <value...>
+//   sample <phase> <bufSize> <seconds>
+
+#define BENCH_RESULTS_HEADER "memory-benchmark-results"
+#define BENCH_RESULTS_VERSION 1
+
+typedef std::pair<std::string, int> PhaseKey; // (phase, buffer size)
+
+struct BenchResults
+{
+    std::vector<std::pair<std::string, std::string>> meta;
+    std::map<PhaseKey, std::vector<double>> samples;
+
+    void Record(const char* phase, int bufSize, double seconds)
+    {
+        samples[PhaseKey(phase, bufSize)].push_back(seconds);
+    }
+
+    std::string Meta(const char* key) const
+    {
+        for (const auto& m : meta)
+        {
+            if (m.first == key)
+                return m.second;
+        }
+        return "";
+    }
+};
+
+inline std::string ReadFirstLine(const char* path, const char* prefix = nullptr)
+{
+    FILE* fp = fopen(path, "r");
+    if (!fp)
+        return "unknown";
+
+    char line[512];
+    std::string result = "unknown";
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (prefix && strncmp(line, prefix, strlen(prefix)) != 0)
+            continue;
+        char* value = line;
+        if (prefix)
+        {
+            value = strchr(line, ':');
+            value = value ? value + 1 : line;
+            while (*value == ' ' || *value == '\t')
+                ++value;
+        }
+        value[strcspn(value, "\n")] = '\0';
+        result = value;
+        break;
+    }
+    fclose(fp);
+    return result;
+}
+
+inline void CollectHostMetadata(BenchResults& results)
+{
+    struct utsname name;
+    uname(&name);
+
+    results.meta.emplace_back("cpu", ReadFirstLine("/proc/cpuinfo", "model name"));
+    results.meta.emplace_back("kernel", std::string(name.release));
+    results.meta.emplace_back("thp", ReadFirstLine("/sys/kernel/mm/transparent_hugepage/enabled"));
+    results.meta.emplace_back("governor", ReadFirstLine("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor"));
+}
+
+inline bool SaveBenchResults(const char* path, const BenchResults& results)
+{
+    FILE* fp = fopen(path, "w");
+    if (!fp)
+        return false;
+
+    fprintf(fp, "%s %d\n", BENCH_RESULTS_HEADER, BENCH_RESULTS_VERSION);
+    for (const auto& m : results.meta)
+        fprintf(fp, "meta %s %s\n", m.first.c_str(), m.second.c_str());
+    for (const auto& s : results.samples)
+    {
+        for (double seconds : s.second)
+            fprintf(fp, "sample %s %d %.9g\n", s.first.first.c_str(), s.first.second, seconds);
+    }
+    return fclose(fp) == 0;
+}
+
+inline bool LoadBenchResults(const char* path, BenchResults& results)
+{
+    FILE* fp = fopen(path, "r");
+    if (!fp)
+        return false;
+
+    char line[1024];
+    int version = 0;
+    char header[64];
+    if (!fgets(line, sizeof(line), fp) || sscanf(line, "%63s %d", header, &version) != 2
+        || strcmp(header, BENCH_RESULTS_HEADER) != 0 || version != BENCH_RESULTS_VERSION)
+    {
+        fclose(fp);
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        line[strcspn(line, "\n")] = '\0';
+        char key[64], phase[64];
+        int bufSize, offset;
+        double seconds;
+        if (sscanf(line, "meta %63s %n", key, &offset) == 1)
+            results.meta.emplace_back(key, line + offset);
+        else if (sscanf(line, "sample %63s %d %lf", phase, &bufSize, &seconds) == 3)
+            results.Record(phase, bufSize, seconds);
+    }
+    fclose(fp);
+    return true;
+}
+
+inline double Median(std::vector<double> v)
+{
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    return n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+// P(U <= u) for samples of n1 and n2 distinct values under the null
+// hypothesis, counting orderings: the largest value is either from the first
+// sample (and beats all n2 of the second) or from the second.
+inline double MannWhitneyExactCdf(int n1, int n2, int u)
+{
+    const int maxU = n1 * n2;
+    auto index = [&](int i, int j, int k) { return ((size_t)i * (n2 + 1) + j) * (maxU + 1) + k; };
+    std::vector<double> ways((size_t)(n1 + 1) * (n2 + 1) * (maxU + 1), 0.0);
+    for (int i = 0; i <= n1; ++i)
+    {
+        for (int j = 0; j <= n2; ++j)
+        {
+            if (i == 0 || j == 0)
+            {
+                ways[index(i, j, 0)] = 1.0;
+                continue;
+            }
+            for (int k = 0; k <= i * j; ++k)
+                ways[index(i, j, k)] = (k >= j ? ways[index(i - 1, j, k - j)] : 0.0) + ways[index(i, j - 1, k)];
+        }
+    }
+
+    double below = 0.0, total = 0.0;
+    for (int k = 0; k <= maxU; ++k)
+    {
+        total += ways[index(n1, n2, k)];
+        if (k <= u)
+            below += ways[index(n1, n2, k)];
+    }
+    return below / total;
+}
+
+// Two-sided Mann-Whitney U test; returns the p-value. Small samples without
+// ties use the exact U distribution (5 vs 5 fully separated gives p = 0.008),
+// larger or tied ones the normal approximation with tie correction.
+inline double MannWhitneyP(const std::vector<double>& a, const std::vector<double>& b)
+{
+    struct Item { double value; int group; };
+    std::vector<Item> all;
+    for (double v : a) all.push_back({ v, 0 });
+    for (double v : b) all.push_back({ v, 1 });
+    std::sort(all.begin(), all.end(), [](const Item& x, const Item& y) { return x.value < y.value; });
+
+    const double n1 = (double)a.size(), n2 = (double)b.size(), n = n1 + n2;
+    double rankSumA = 0.0, tieTerm = 0.0;
+    for (size_t i = 0; i < all.size();)
+    {
+        size_t j = i;
+        while (j < all.size() && all[j].value == all[i].value)
+            ++j;
+        double rank = 0.5 * (double)(i + 1 + j); // average of ranks i+1..j
+        double ties = (double)(j - i);
+        tieTerm += ties * ties * ties - ties;
+        for (size_t k = i; k < j; ++k)
+        {
+            if (all[k].group == 0)
+                rankSumA += rank;
+        }
+        i = j;
+    }
+
+    double u = rankSumA - n1 * (n1 + 1) / 2;
+    if (tieTerm == 0 && a.size() <= 20 && b.size() <= 20 && !a.empty() && !b.empty())
+    {
+        int low = (int)std::min(u, n1 * n2 - u);
+        return std::min(1.0, 2 * MannWhitneyExactCdf((int)a.size(), (int)b.size(), low));
+    }
+
+    double mean = n1 * n2 / 2;
+    double variance = n1 * n2 / 12 * ((n + 1) - tieTerm / (n * (n - 1)));
+    if (variance <= 0)
+        return 1.0;
+    double z = (fabs(u - mean) - 0.5) / sqrt(variance);
+    return std::min(1.0, erfc(std::max(0.0, z) / sqrt(2.0)));
+}
+
+// 95% bootstrap confidence interval of median(current) / median(baseline).
+inline std::pair<double, double> BootstrapRatioCI(const std::vector<double>& baseline, const std::vector<double>& current, int resamples = 2000)
+{
+    std::mt19937 rng(12345);
+    std::vector<double> ratios, bs(baseline.size()), cs(current.size());
+    for (int r = 0; r < resamples; ++r)
+    {
+        for (double& v : bs) v = baseline[rng() % baseline.size()];
+        for (double& v : cs) v = current[rng() % current.size()];
+        double base = Median(bs);
+        if (base > 0)
+            ratios.push_back(Median(cs) / base);
+    }
+    if (ratios.empty())
+        return { 1.0, 1.0 };
+    std::sort(ratios.begin(), ratios.end());
+    return { ratios[(size_t)(0.025 * (ratios.size() - 1))], ratios[(size_t)(0.975 * (ratios.size() - 1))] };
+}
+
+// Prints one line per phase/size present in both runs and returns how many
+// regressed: significant at `alpha` and slower by more than `minEffect`.
+inline int CompareBenchResults(const BenchResults& baseline, const BenchResults& current, double alpha = 0.01, double minEffect = 0.05)
+{
+    for (const auto& m : current.meta)
+    {
+        std::string old = baseline.Meta(m.first.c_str());
+        if (old != m.second)
+            printf("warning: %s differs from baseline (%s -> %s)\n", m.first.c_str(), old.c_str(), m.second.c_str());
+    }
+
+    printf("%-22s %8s %12s %12s %8s %17s %9s\n", "phase", "MB", "base (s)", "now (s)", "ratio", "95% CI", "p");
+    int regressions = 0;
+    for (const auto& s : current.samples)
+    {
+        auto it = baseline.samples.find(s.first);
+        if (it == baseline.samples.end())
+            continue;
+
+        const std::vector<double>& base = it->second;
+        const std::vector<double>& now = s.second;
+        double baseMedian = Median(base), nowMedian = Median(now);
+        double ratio = baseMedian > 0 ? nowMedian / baseMedian : 1.0;
+        double p = MannWhitneyP(base, now);
+        auto ci = BootstrapRatioCI(base, now);
+
+        const char* verdict = "";
+        if (base.size() < 5 || now.size() < 5)
+            verdict = "too few runs";
+        else if (p < alpha && ci.first > 1.0 + minEffect)
+        {
+            verdict = "REGRESSION";
+            ++regressions;
+        }
+        else if (p < alpha && ci.second < 1.0 - minEffect)
+            verdict = "improved";
+
+        printf("%-22s %8d %12.6f %12.6f %8.3f [%6.3f, %6.3f] %9.2g %s\n", s.first.first.c_str(), s.first.second / (1024 * 1024),
+            baseMedian, nowMedian, ratio, ci.first, ci.second, p, verdict);
+    }
+    return regressions;
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "stable_clock.h"
+
+// Copy-path family for the memory harness: library copies, explicit vector
+// loops and a non-temporal store variant that bypasses the cache, measured
+// over sizes from L1-resident to DRAM-bound and over misaligned buffers.
+
+typedef void (*CopyFunction)(char* dst, const char* src, size_t n);
+
+inline void CopyMemcpy(char* dst, const char* src, size_t n) { memcpy(dst, src, n); }
+inline void CopyMemmove(char* dst, const char* src, size_t n) { memmove(dst, src, n); }
+inline void CopyStd(char* dst, const char* src, size_t n) { std::copy(src, src + n, dst); }
+
+#if defined(__x86_64__)
+inline void CopySse2(char* dst, const char* src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + i + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*)(src + i + 48));
+        _mm_storeu_si128((__m128i*)(dst + i), a);
+        _mm_storeu_si128((__m128i*)(dst + i + 16), b);
+        _mm_storeu_si128((__m128i*)(dst + i + 32), c);
+        _mm_storeu_si128((__m128i*)(dst + i + 48), d);
+    }
+    memcpy(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline void CopyAvx2(char* dst, const char* src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 32));
+        _mm256_storeu_si256((__m256i*)(dst + i), a);
+        _mm256_storeu_si256((__m256i*)(dst + i + 32), b);
+    }
+    memcpy(dst + i, src + i, n - i);
+}
+
+// Streaming stores need an aligned destination: copy the head normally,
+// stream the aligned middle and fence so the data is visible to other cores.
+inline void CopyNonTemporal(char* dst, const char* src, size_t n)
+{
+    size_t head = (16 - ((uintptr_t)dst & 15)) & 15;
+    head = std::min(head, n);
+    memcpy(dst, src, head);
+
+    size_t i = head;
+    for (; i + 64 <= n; i += 64)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + i + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*)(src + i + 48));
+        _mm_stream_si128((__m128i*)(dst + i), a);
+        _mm_stream_si128((__m128i*)(dst + i + 16), b);
+        _mm_stream_si128((__m128i*)(dst + i + 32), c);
+        _mm_stream_si128((__m128i*)(dst + i + 48), d);
+    }
+    _mm_sfence();
+    memcpy(dst + i, src + i, n - i);
+}
+#endif
+
+// Best of three rounds, each repeating the copy for at least ~20 ms.
+inline double MeasureCopy(CopyFunction copy, char* dst, const char* src, size_t n)
+{
+    size_t repeats = std::max<size_t>(1, (64u << 20) / n);
+    double best = 0.0;
+    for (int round = 0; round < 3; ++round)
+    {
+        for (;;)
+        {
+            TscTimer timer;
+            for (size_t r = 0; r < repeats; ++r)
+            {
+                copy(dst, src, n);
+                __asm__ volatile("" : : "g"(dst) : "memory");
+            }
+            double seconds = timer.GetElapsed();
+            if (seconds < 0.02)
+            {
+                repeats *= 2;
+                continue;
+            }
+            best = std::max(best, (double)n * repeats / seconds);
+            break;
+        }
+    }
+    return best;
+}
+
+inline void MeasureCopyFamily()
+{
+    struct { const char* name; CopyFunction fn; } copies[] =
+    {
+        { "memcpy", CopyMemcpy },
+        { "memmove", CopyMemmove },
+        { "std::copy", CopyStd },
+#if defined(__x86_64__)
+        { "sse2", CopySse2 },
+        { "avx2", __builtin_cpu_supports("avx2") ? CopyAvx2 : nullptr },
+        { "nt-store", CopyNonTemporal },
+#endif
+    };
+    const size_t sizes[] = { 4 << 10, 64 << 10, 1 << 20, 16 << 20, 64 << 20 };
+    const size_t alignments[] = { 0, 1, 8, 32 }; // byte offset applied to src and dst
+
+    const size_t maxSize = 64 << 20;
+    char* src = (char*)aligned_alloc(4096, maxSize + 4096);
+    char* dst = (char*)aligned_alloc(4096, maxSize + 4096);
+    memset(src, 1, maxSize + 4096);
+    memset(dst, 0, maxSize + 4096);
+
+    printf("Measuring copy throughput (GB/s, src/dst offset from 4 KB alignment)...\n");
+    printf("%-10s %8s", "", "offset");
+    for (const auto& c : copies)
+        printf(" %10s", c.name);
+    printf("\n");
+
+    for (size_t size : sizes)
+    {
+        for (size_t align : alignments)
+        {
+            printf("%7zu KB %8zu", size >> 10, align);
+            for (const auto& c : copies)
+            {
+                if (c.fn)
+                    printf(" %10.2f", MeasureCopy(c.fn, dst + align, src + align, size) * 1e-9);
+                else
+                    printf(" %10s", "n/a");
+            }
+            printf("\n");
+        }
+    }
+
+    free(src);
+    free(dst);
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#include "stable_clock.h"
+
+// Inter-core communication costs for every ordered pair of allowed CPUs:
+// cache-line ping-pong round-trip latency and the throughput two cores get
+// when their counters share a line (false sharing) vs. sit on separate lines.
+
+struct alignas(64) CacheLine
+{
+    std::atomic<uint64_t> value{ 0 };
+};
+
+// Round-trip time of one cache line bouncing between `a` and `b`, in ns.
+inline double PingPongLatency(int a, int b, int roundTrips)
+{
+    CacheLine line;
+    std::thread pong([&]
+    {
+        PinCurrentThread(b);
+        for (int i = 0; i < roundTrips; ++i)
+        {
+            uint64_t expected = 2 * (uint64_t)i + 1;
+            while (line.value.load(std::memory_order_acquire) != expected)
+                ;
+            line.value.store(expected + 1, std::memory_order_release);
+        }
+    });
+
+    PinCurrentThread(a);
+    // Let the partner thread reach its spin loop before the clock starts.
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < roundTrips; ++i)
+    {
+        uint64_t sent = 2 * (uint64_t)i + 1;
+        line.value.store(sent, std::memory_order_release);
+        while (line.value.load(std::memory_order_acquire) != sent + 1)
+            ;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    pong.join();
+    return seconds / roundTrips * 1e9;
+}
+
+// Combined increments per second of two threads on `a` and `b`, each owning
+// one counter. `shared` places both counters in the same cache line.
+inline double CounterThroughput(int a, int b, bool shared, std::chrono::milliseconds duration)
+{
+    struct alignas(64) Counters
+    {
+        std::atomic<uint64_t> first{ 0 };
+        std::atomic<uint64_t> neighbour{ 0 };   // same line as `first`
+        alignas(64) std::atomic<uint64_t> padded{ 0 };
+    } counters;
+
+    std::atomic<uint64_t>& second = shared ? counters.neighbour : counters.padded;
+    std::atomic<bool> stop{ false };
+    auto work = [&stop](int cpu, std::atomic<uint64_t>& counter)
+    {
+        PinCurrentThread(cpu);
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            for (int i = 0; i < 1024; ++i)
+                counter.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+
+    std::thread t1(work, a, std::ref(counters.first));
+    std::thread t2(work, b, std::ref(second));
+    std::this_thread::sleep_for(duration);
+    stop.store(true);
+    t1.join();
+    t2.join();
+
+    double seconds = std::chrono::duration<double>(duration).count();
+    return (double)(counters.first.load() + second.load()) / seconds;
+}
+
+// `allowed` is the CPU set the process started with: with --pin the main
+// thread's own affinity is a single CPU by the time the matrix runs.
+inline void MeasureCoreToCore(const cpu_set_t& allowed)
+{
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &allowed))
+            cpus.push_back(cpu);
+    }
+
+    if (cpus.size() < 2)
+    {
+        printf("Core-to-core matrix needs at least two CPUs, %zu available.\n", cpus.size());
+        return;
+    }
+
+    auto printHeader = [&](const char* title)
+    {
+        printf("%s\n%6s", title, "");
+        for (int cpu : cpus)
+            printf(" %7d", cpu);
+        printf("\n");
+    };
+
+    printHeader("Cache-line ping-pong round trip (ns), row pings column:");
+    for (int a : cpus)
+    {
+        printf("%6d", a);
+        for (int b : cpus)
+        {
+            if (a == b)
+                printf(" %7s", "-");
+            else
+                printf(" %7.1f", PingPongLatency(a, b, 20000));
+        }
+        printf("\n");
+    }
+
+    printHeader("False-sharing slowdown (padded / shared counter throughput):");
+    for (int a : cpus)
+    {
+        printf("%6d", a);
+        for (int b : cpus)
+        {
+            if (a == b)
+            {
+                printf(" %7s", "-");
+                continue;
+            }
+            double shared = CounterThroughput(a, b, true, std::chrono::milliseconds(20));
+            double padded = CounterThroughput(a, b, false, std::chrono::milliseconds(20));
+            printf(" %6.1fx", shared > 0 ? padded / shared : 0.0);
+        }
+        printf("\n");
+    }
+
+    // Restore the affinity the harness started with.
+    sched_setaffinity(0, sizeof(allowed), &allowed);
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <execution>
+#include <numeric>
+#include <stdint.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Native counterparts of the managed workloads: RunTest from
+// Alocacao/AlocacaoCSharp/Program.cs and Alocacao/alocac.py (fill 10M ints
+// with their index, then sum them) and the buffer sweep from
+// BuffersCreate/AlocacaoCSharp/Program.cs. Parameters and output lines match
+// the originals so the three languages can be compared line by line.
+
+// Keeps the compiler from proving a buffer is dead and deleting the work.
+inline void Escape(void* p)
+{
+    __asm__ volatile("" : : "g"(p) : "memory");
+}
+
+inline long long FillReduceSerial(int* array, int size)
+{
+    for (int i = 0; i < size; i++)
+        array[i] = i;
+
+    long long sum = 0;
+    for (int i = 0; i < size; i++)
+        sum += array[i];
+    return sum;
+}
+
+inline long long FillReduceParUnseq(int* array, int size)
+{
+    std::for_each(std::execution::par_unseq, array, array + size, [array](int& value) { value = (int)(&value - array); });
+    return std::transform_reduce(std::execution::par_unseq, array, array + size, 0LL, std::plus<long long>(), [](int value) { return (long long)value; });
+}
+
+inline long long FillReduceThreaded(int* array, int size)
+{
+    unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<long long> partial(threadCount * 8); // one cache line per thread
+    std::vector<std::thread> threads;
+
+    for (unsigned t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back([=, &partial]
+        {
+            int begin = (int)((long long)size * t / threadCount);
+            int end = (int)((long long)size * (t + 1) / threadCount);
+            for (int i = begin; i < end; i++)
+                array[i] = i;
+            long long sum = 0;
+            for (int i = begin; i < end; i++)
+                sum += array[i];
+            partial[t * 8] = sum;
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    long long sum = 0;
+    for (unsigned t = 0; t < threadCount; ++t)
+        sum += partial[t * 8];
+    return sum;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2"))) inline long long FillReduceAvx2(int* array, int size)
+{
+    int i = 0;
+    __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i step = _mm256_set1_epi32(8);
+    for (; i + 8 <= size; i += 8)
+    {
+        _mm256_storeu_si256((__m256i*)(array + i), index);
+        index = _mm256_add_epi32(index, step);
+    }
+    for (; i < size; i++)
+        array[i] = i;
+
+    // Widen to 64-bit lanes before adding so the sum cannot wrap.
+    __m256i lo = _mm256_setzero_si256(), hi = _mm256_setzero_si256();
+    for (i = 0; i + 8 <= size; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(array + i));
+        lo = _mm256_add_epi64(lo, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+        hi = _mm256_add_epi64(hi, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+    }
+    alignas(32) long long lanes[4];
+    _mm256_store_si256((__m256i*)lanes, _mm256_add_epi64(lo, hi));
+    long long sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; i < size; i++)
+        sum += array[i];
+    return sum;
+}
+#endif
+
+inline long long FillReduceSimd(int* array, int size)
+{
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2"))
+        return FillReduceAvx2(array, size);
+#endif
+    return FillReduceSerial(array, size);
+}
+
+// Mirrors RunTest(size) + Main() of the C# version for one variant.
+inline void RunTest(const char* variant, long long (*fillReduce)(int*, int), int size)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // Alocar memória
+    int* array = new int[size];
+    // Preencher o vetor e somar os elementos
+    long long sum = fillReduce(array, size);
+    Escape(array);
+    delete[] array;
+
+    printf("Soma: %lld\n", sum);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Tempo de execução em C++ (%s): %.15g segundos\n", variant, seconds);
+}
+
+inline void MeasureFillReduce(int size)
+{
+    RunTest("serial", FillReduceSerial, size);
+    RunTest("par_unseq", FillReduceParUnseq, size);
+    RunTest("threads", FillReduceThreaded, size);
+    RunTest("simd", FillReduceSimd, size);
+}
+
+// BuffersCreate: allocate and initialize `bufSize` bytes IterationCount times.
+inline void MeasureBufferInit(int bufSize)
+{
+    const int IterationCount = 100;
+    printf("Testando com buffer de %d MB\n", bufSize / (1024 * 1024));
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < IterationCount; i++)
+    {
+        int count = bufSize / (int)sizeof(int);
+        int* array = new int[count](); // new int[] in C# is zeroed too
+        for (int j = 0; j < count; j++)
+            array[j] = j;
+        Escape(array);
+        delete[] array;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Tempo gasto para alocar e inicializar %d MB %d vezes: %.4f segundos\n", bufSize / (1024 * 1024), IterationCount, seconds);
+}
+
+inline void MeasureBufferSweep()
+{
+    printf("Digite os tamanhos de buffer em MB (digite '0' para sair):\n");
+
+    char line[64];
+    while (fgets(line, sizeof(line), stdin))
+    {
+        int size;
+        if (sscanf(line, "%d", &size) == 1 && size >= 0)
+        {
+            if (size == 0)
+                break;
+            MeasureBufferInit(size * 1024 * 1024); // Convertendo MB para bytes
+        }
+        else
+        {
+            printf("Por favor, insira um número válido.\n");
+        }
+    }
+}
@@ -1,9 +1,18 @@
 #include <iostream>
 #include <chrono>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <vector>
 
+#include "alloc_trace.h"
+#include "bench_results.h"
+#include "copy_bench.h"
+#include "core_to_core.h"
+#include "fill_reduce.h"
+#include "perf_counters.h"
+#include "stable_clock.h"
+
 class Timer
 {
 public:
@@ -26,56 +35,83 @@ private:
     Timer operator=(const Timer*) = delete;
 };
 
-void BusyWait(int ms)
+struct Options
 {
-    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
-    for (;;)
-    {
-        if (std::chrono::steady_clock::now() > end)
-            break;
-    }
-}
+    int pinCpu = -1;                // -1: let the scheduler place the thread
+    double warmUpTolerance = 0.01;  // relative spread of the last samples
+    int warmUpMaxMs = 5000;
+    const char* tracePath = nullptr;      // replay this allocation trace
+    size_t syntheticRecords = 0;          // or generate one with this many allocations
+    const char* saveTracePath = nullptr;  // where to keep the generated trace
+    double crossThreadFraction = 0.1;
+    unsigned threads = 0;                 // 0: one per hardware thread
+    bool fillReduce = false;              // C#/Python RunTest workload
+    bool bufferSweep = false;             // BuffersCreate workload, sizes from stdin
+    bool copy = false;                    // memcpy/memmove/SIMD/non-temporal copies
+    bool coreMatrix = false;              // ping-pong and false sharing per CPU pair
+    int repetitions = 1;                  // runs of the allocation phases
+    const char* savePath = nullptr;       // write results + host metadata here
+    const char* baselinePath = nullptr;   // compare against these results
+};
 
-void MeasureMemoryAllocation(int bufSize, int iterationCount)
+void MeasureMemoryAllocation(int bufSize, int iterationCount, BenchResults& results)
 {
     printf("Measuring memory allocation for %d MB...\n", bufSize / (1024 * 1024));
-    
+    const double bytesTouched = (double)bufSize * iterationCount;
+
     {
         Timer timer;
+        PerfCounters counters;
         for (int i = 0; i < iterationCount; ++i)
         {
             int* p = new int[bufSize / sizeof(int)];
             delete[] p;
         }
-        printf("%1.4f s to allocate %d MB %d times.\n", timer.GetElapsed(), bufSize / (1024 * 1024), iterationCount);
+        counters.Read();
+        double elapsed = timer.GetElapsed();
+        printf("%1.4f s to allocate %d MB %d times.\n", elapsed, bufSize / (1024 * 1024), iterationCount);
+        results.Record("allocate", bufSize, elapsed);
+        counters.Print(bytesTouched);
     }
 
     {
         Timer timer;
+        PerfCounters counters;
         double deleteTime = 0.0;
         for (int i = 0; i < iterationCount; ++i)
         {
             int* p = new int[bufSize / sizeof(int)];
-            Timer deleteTimer;
+            TscTimer deleteTimer;
             delete[] p;
             deleteTime += deleteTimer.GetElapsed();
         }
-        printf("%1.4f s to allocate %d MB %d times (%1.4f s to delete).\n", timer.GetElapsed(), bufSize / (1024 * 1024), iterationCount, deleteTime);
+        counters.Read();
+        double elapsed = timer.GetElapsed();
+        printf("%1.4f s to allocate %d MB %d times (%1.6f s to delete).\n", elapsed, bufSize / (1024 * 1024), iterationCount, deleteTime);
+        results.Record("allocate-delete", bufSize, elapsed);
+        results.Record("allocate-delete:delete", bufSize, deleteTime);
+        counters.Print(bytesTouched);
     }
 
     {
         int* p = new int[bufSize / sizeof(int)]();
         {
             Timer timer;
+            PerfCounters counters;
             for (int i = 0; i < iterationCount; ++i)
             {
                 memset(p, 1, bufSize);
             }
-            printf("%1.4f s to write %d MB %d times.\n", timer.GetElapsed(), bufSize / (1024 * 1024), iterationCount);
+            counters.Read();
+            double elapsed = timer.GetElapsed();
+            printf("%1.4f s to write %d MB %d times.\n", elapsed, bufSize / (1024 * 1024), iterationCount);
+            results.Record("write", bufSize, elapsed);
+            counters.Print(bytesTouched);
         }
         {
             Timer timer;
-            int sum = 0;
+            PerfCounters counters;
+            long long sum = 0;
             for (int i = 0; i < iterationCount; ++i)
             {
                 for (size_t index = 0; index < bufSize / sizeof(int); ++index)
@@ -83,28 +119,39 @@ void MeasureMemoryAllocation(int bufSize, int iterationCount)
                     sum += p[index];
                 }
             }
-            printf("%1.4f s to read %d MB %d times, sum = %d.\n", timer.GetElapsed(), bufSize / (1024 * 1024), iterationCount, sum);
+            counters.Read();
+            double elapsed = timer.GetElapsed();
+            printf("%1.4f s to read %d MB %d times, sum = %lld.\n", elapsed, bufSize / (1024 * 1024), iterationCount, sum);
+            results.Record("read", bufSize, elapsed);
+            counters.Print(bytesTouched);
         }
         delete[] p;
     }
 
     {
         Timer timer;
+        PerfCounters counters;
         double deleteTime = 0.0;
         for (int i = 0; i < iterationCount; ++i)
         {
             int* p = new int[bufSize / sizeof(int)];
             memset(p, 1, bufSize);
-            Timer deleteTimer;
+            TscTimer deleteTimer;
             delete[] p;
             deleteTime += deleteTimer.GetElapsed();
         }
-        printf("%1.4f s to allocate and write %d MB %d times (%1.4f s to delete).\n", timer.GetElapsed(), bufSize / (1024 * 1024), iterationCount, deleteTime);
+        counters.Read();
+        double elapsed = timer.GetElapsed();
+        printf("%1.4f s to allocate and write %d MB %d times (%1.6f s to delete).\n", elapsed, bufSize / (1024 * 1024), iterationCount, deleteTime);
+        results.Record("allocate-write", bufSize, elapsed);
+        results.Record("allocate-write:delete", bufSize, deleteTime);
+        counters.Print(bytesTouched);
     }
 
     {
         Timer timer;
-        int sum = 0;
+        PerfCounters counters;
+        long long sum = 0;
         for (int i = 0; i < iterationCount; ++i)
         {
             int* p = new int[bufSize / sizeof(int)];
@@ -114,27 +161,159 @@ void MeasureMemoryAllocation(int bufSize, int iterationCount)
             }
             delete[] p;
         }
-        printf("%1.4f s to allocate and read %d MB %d times, sum = % d.\n", timer.GetElapsed(), bufSize / (1024 * 1024), iterationCount, sum);
+        counters.Read();
+        double elapsed = timer.GetElapsed();
+        printf("%1.4f s to allocate and read %d MB %d times, sum = %lld.\n", elapsed, bufSize / (1024 * 1024), iterationCount, sum);
+        results.Record("allocate-read", bufSize, elapsed);
+        counters.Print(bytesTouched);
     }
 }
 
-void FastMeasure()
+int FastMeasure(const Options& options)
 {
-    printf("Busy waiting to raise the CPU frequency...\n");
-    BusyWait(500);
+    // Taken before pinning, so the core matrix still sees every allowed CPU.
+    cpu_set_t startupCpus;
+    CPU_ZERO(&startupCpus);
+    sched_getaffinity(0, sizeof(startupCpus), &startupCpus);
+
+    if (options.pinCpu >= 0)
+    {
+        if (PinCurrentThread(options.pinCpu))
+            printf("Pinned to CPU %d.\n", options.pinCpu);
+        else
+            printf("Could not pin to CPU %d, running unpinned.\n", options.pinCpu);
+    }
+
+    printf("Warming up until the CPU frequency is stable...\n");
+    WarmUp(options.warmUpTolerance, options.warmUpMaxMs);
+    if (TscClock::Available())
+        printf("Using invariant TSC at %.3f GHz (%llu ticks read overhead) for short phases.\n",
+            TscClock::TicksPerSecond() * 1e-9, (unsigned long long)TscClock::OverheadTicks());
     
+    if (options.copy || options.coreMatrix)
+    {
+        if (options.copy)
+            MeasureCopyFamily();
+        if (options.coreMatrix)
+            MeasureCoreToCore(startupCpus);
+        return 0;
+    }
+
+    if (options.fillReduce || options.bufferSweep)
+    {
+        if (options.fillReduce)
+            MeasureFillReduce(10000000); // 10 milhões
+        if (options.bufferSweep)
+            MeasureBufferSweep();
+        return 0;
+    }
+
+    if (options.tracePath || options.syntheticRecords)
+    {
+        unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+        AllocTrace trace;
+        if (options.tracePath)
+        {
+            if (!LoadAllocTrace(options.tracePath, trace))
+            {
+                printf("Could not read allocation trace %s.\n", options.tracePath);
+                return 0;
+            }
+        }
+        else
+        {
+            trace = GenerateAllocTrace(options.syntheticRecords, threads, options.crossThreadFraction, 42);
+            if (options.saveTracePath && !SaveAllocTrace(options.saveTracePath, trace))
+                printf("Could not write allocation trace %s.\n", options.saveTracePath);
+        }
+        MeasureAllocTrace(trace, threads);
+        return 0;
+    }
+
     std::vector<int> bufferSizes = {32 * 1024 * 1024 }; // 1MB, 4MB, 16MB, 32MB
     const int iterationCount = 100;
 
-    for (int bufSize : bufferSizes)
+    BenchResults results;
+    CollectHostMetadata(results);
+    for (int run = 0; run < options.repetitions; ++run)
+    {
+        for (int bufSize : bufferSizes)
+        {
+            MeasureMemoryAllocation(bufSize, iterationCount, results);
+        }
+    }
+
+    if (options.savePath)
+    {
+        if (SaveBenchResults(options.savePath, results))
+            printf("Results saved to %s.\n", options.savePath);
+        else
+            printf("Could not write results to %s.\n", options.savePath);
+    }
+
+    if (options.baselinePath)
     {
-        MeasureMemoryAllocation(bufSize, iterationCount);
+        BenchResults baseline;
+        if (!LoadBenchResults(options.baselinePath, baseline))
+        {
+            printf("Could not read baseline %s.\n", options.baselinePath);
+            return 1;
+        }
+        printf("Comparing against baseline %s...\n", options.baselinePath);
+        int regressions = CompareBenchResults(baseline, results);
+        if (regressions > 0)
+        {
+            printf("%d phase(s) regressed.\n", regressions);
+            return 2;
+        }
     }
+    return 0;
 }
 
 int main(int argc, char* argv[])
 {
-    FastMeasure();
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--pin") == 0 && i + 1 < argc)
+            options.pinCpu = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--warmup-tolerance") == 0 && i + 1 < argc)
+            options.warmUpTolerance = atof(argv[++i]) / 100.0;
+        else if (strcmp(argv[i], "--warmup-max-ms") == 0 && i + 1 < argc)
+            options.warmUpMaxMs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            options.tracePath = argv[++i];
+        else if (strcmp(argv[i], "--synthetic-trace") == 0 && i + 1 < argc)
+            options.syntheticRecords = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--save-trace") == 0 && i + 1 < argc)
+            options.saveTracePath = argv[++i];
+        else if (strcmp(argv[i], "--cross-thread") == 0 && i + 1 < argc)
+            options.crossThreadFraction = atof(argv[++i]) / 100.0;
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            options.threads = (unsigned)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--fill-reduce") == 0)
+            options.fillReduce = true;
+        else if (strcmp(argv[i], "--buffer-sweep") == 0)
+            options.bufferSweep = true;
+        else if (strcmp(argv[i], "--copy") == 0)
+            options.copy = true;
+        else if (strcmp(argv[i], "--core-matrix") == 0)
+            options.coreMatrix = true;
+        else if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc)
+            options.repetitions = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc)
+            options.savePath = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+            options.baselinePath = argv[++i];
+        else
+        {
+            printf("Usage: %s [--pin CPU] [--warmup-tolerance PERCENT] [--warmup-max-ms MS]\n"
+                   "       [--trace FILE | --synthetic-trace N [--save-trace FILE] [--cross-thread PERCENT]] [--threads N]\n"
+                   "       [--fill-reduce] [--buffer-sweep] [--copy] [--core-matrix]\n"
+                   "       [--repetitions N] [--save FILE] [--baseline FILE]\n", argv[0]);
+            return 1;
+        }
+    }
 
-    return 0;
+    return FastMeasure(options);
 }
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Hardware/software events sampled by PerfCounters, in report order.
+enum PerfEvent
+{
+    PerfCycles,
+    PerfInstructions,
+    PerfLlcLoads,
+    PerfLlcMisses,
+    PerfDtlbMisses,
+    PerfPageFaults,
+    PerfEventCount
+};
+
+// Counter values read at the end of a scope. An event the kernel or the
+// hypervisor refused to open is reported as unavailable instead of zero.
+struct PerfSample
+{
+    uint64_t value[PerfEventCount] = {};
+    bool available[PerfEventCount] = {};
+
+    bool Has(PerfEvent event) const { return available[event]; }
+    double Get(PerfEvent event) const { return (double)value[event]; }
+};
+
+// RAII group of perf_event_open counters covering the same scope as a Timer.
+// Each event is opened on its own so that one missing PMU event (common in
+// VMs and containers) does not take the others down with it; values are
+// scaled by time_enabled / time_running when the kernel multiplexes them.
+class PerfCounters
+{
+public:
+    PerfCounters()
+    {
+        static const struct { uint32_t type; uint64_t config; } events[PerfEventCount] =
+        {
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+            { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16) },
+            { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+            { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+            { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+        };
+
+        for (int i = 0; i < PerfEventCount; ++i)
+        {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = events[i].type;
+            attr.config = events[i].config;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+
+        for (int i = 0; i < PerfEventCount; ++i)
+        {
+            if (fds[i] >= 0)
+            {
+                ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+                ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+
+    ~PerfCounters()
+    {
+        for (int i = 0; i < PerfEventCount; ++i)
+        {
+            if (fds[i] >= 0)
+                close(fds[i]);
+        }
+    }
+
+    // Stops counting and returns the values accumulated since construction.
+    // Further calls return the same sample.
+    PerfSample Read()
+    {
+        if (stopped)
+            return sample;
+
+        for (int i = 0; i < PerfEventCount; ++i)
+        {
+            if (fds[i] >= 0)
+                ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+        stopped = true;
+
+        for (int i = 0; i < PerfEventCount; ++i)
+        {
+            uint64_t data[3];
+            if (fds[i] < 0 || read(fds[i], data, sizeof(data)) != (ssize_t)sizeof(data) || data[2] == 0)
+                continue;
+
+            double scale = (double)data[1] / (double)data[2];
+            sample.value[i] = (uint64_t)((double)data[0] * scale);
+            sample.available[i] = true;
+        }
+        return sample;
+    }
+
+    // Prints derived metrics for a phase that touched `bytes` bytes of memory.
+    void Print(double bytes)
+    {
+        PerfSample s = Read();
+
+        printf("    ");
+        if (s.Has(PerfCycles) && s.Has(PerfInstructions) && s.Get(PerfCycles) > 0)
+            printf("IPC %.2f", s.Get(PerfInstructions) / s.Get(PerfCycles));
+        else
+            printf("IPC n/a");
+
+        if (s.Has(PerfLlcLoads) && s.Has(PerfLlcMisses) && s.Get(PerfLlcLoads) > 0)
+            printf(", LLC miss %.1f%%", 100.0 * s.Get(PerfLlcMisses) / s.Get(PerfLlcLoads));
+        else
+            printf(", LLC miss n/a");
+
+        if (s.Has(PerfDtlbMisses) && bytes > 0)
+            printf(", dTLB miss %.2f/KB", s.Get(PerfDtlbMisses) * 1024.0 / bytes);
+        else
+            printf(", dTLB miss n/a");
+
+        if (s.Has(PerfPageFaults))
+            printf(", %llu page faults", (unsigned long long)s.value[PerfPageFaults]);
+        else
+            printf(", page faults n/a");
+
+        if (s.Has(PerfCycles) && s.Get(PerfCycles) > 0)
+            printf(", %.2f B/cycle", bytes / s.Get(PerfCycles));
+        else
+            printf(", B/cycle n/a");
+
+        printf("\n");
+    }
+
+private:
+    int fds[PerfEventCount];
+    PerfSample sample;
+    bool stopped = false;
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters operator=(const PerfCounters&) = delete;
+};
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <chrono>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+#include "perf_counters.h"
+
+// Pins the calling thread to `cpu`. Returns false if the affinity call fails.
+inline bool PinCurrentThread(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+// Invariant TSC clock. Calibrated once against steady_clock; the cost of a
+// back-to-back read pair is measured so timers can subtract it.
+class TscClock
+{
+public:
+    static bool Available()
+    {
+        return Get().invariant;
+    }
+
+    static uint64_t Start()
+    {
+#if HAVE_TSC
+        _mm_lfence();
+        uint64_t t = __rdtsc();
+        _mm_lfence();
+        return t;
+#else
+        return 0;
+#endif
+    }
+
+    static uint64_t Stop()
+    {
+#if HAVE_TSC
+        unsigned aux;
+        uint64_t t = __rdtscp(&aux);
+        _mm_lfence();
+        return t;
+#else
+        return 0;
+#endif
+    }
+
+    static double TicksPerSecond() { return Get().ticksPerSecond; }
+    static uint64_t OverheadTicks() { return Get().overhead; }
+
+private:
+    bool invariant = false;
+    double ticksPerSecond = 0.0;
+    uint64_t overhead = 0;
+
+    static const TscClock& Get()
+    {
+        static const TscClock clock = Calibrate();
+        return clock;
+    }
+
+    static TscClock Calibrate()
+    {
+        TscClock c;
+#if HAVE_TSC
+        unsigned eax, ebx, ecx, edx;
+        if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) && eax >= 0x80000007)
+        {
+            __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+            c.invariant = (edx & (1u << 8)) != 0;
+        }
+        if (!c.invariant)
+            return c;
+
+        // Take the median of a few 10 ms windows so one preemption does not skew it.
+        std::vector<double> rates;
+        for (int i = 0; i < 5; ++i)
+        {
+            auto wallStart = std::chrono::steady_clock::now();
+            uint64_t tscStart = Start();
+            while (std::chrono::steady_clock::now() - wallStart < std::chrono::milliseconds(10))
+                ;
+            uint64_t tscEnd = Stop();
+            auto wallEnd = std::chrono::steady_clock::now();
+            double seconds = std::chrono::duration<double>(wallEnd - wallStart).count();
+            rates.push_back((double)(tscEnd - tscStart) / seconds);
+        }
+        std::sort(rates.begin(), rates.end());
+        c.ticksPerSecond = rates[rates.size() / 2];
+
+        uint64_t best = UINT64_MAX;
+        for (int i = 0; i < 1000; ++i)
+        {
+            uint64_t a = Start();
+            uint64_t b = Stop();
+            best = std::min(best, b - a);
+        }
+        c.overhead = best;
+#endif
+        return c;
+    }
+};
+
+// Timer with the same interface as Timer, backed by the invariant TSC when the
+// CPU has one and by steady_clock otherwise. Meant for short phases where the
+// steady_clock call cost is a visible fraction of the measurement.
+class TscTimer
+{
+public:
+    TscTimer() : usesTsc(TscClock::Available())
+    {
+        if (usesTsc)
+            startTicks = TscClock::Start();
+        else
+            start = std::chrono::steady_clock::now();
+    }
+    // Returns the duration in seconds, minus the cost of reading the clock.
+    double GetElapsed()
+    {
+        if (!usesTsc)
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        uint64_t ticks = TscClock::Stop() - startTicks;
+        uint64_t overhead = TscClock::OverheadTicks();
+        ticks = ticks > overhead ? ticks - overhead : 0;
+        return (double)ticks / TscClock::TicksPerSecond();
+    }
+private:
+    const bool usesTsc; // fixed at construction: start and stop read the same clock
+    uint64_t startTicks = 0;
+    std::chrono::steady_clock::time_point start;
+
+    TscTimer(const TscTimer&) = delete;
+    TscTimer operator=(const TscTimer&) = delete;
+};
+
+// Spins a dependent integer chain so the work per call is constant regardless
+// of memory or branch behaviour.
+inline uint64_t WarmUpKernel(uint64_t seed, int rounds)
+{
+    for (int i = 0; i < rounds; ++i)
+    {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        __asm__ volatile("" : "+r"(seed));
+    }
+    return seed;
+}
+
+// Warm-up samples of one run. The unit is chosen once, before the first
+// slice, so the stability window never compares cycles with seconds.
+struct WarmUpSamples
+{
+    bool cycles = false;        // true: cycles per wall second; false: seconds per slice
+    std::vector<double> values;
+};
+
+// Replaces a fixed busy wait: runs the kernel in ~5 ms slices until the last
+// `window` samples agree within `tolerance` (relative spread) or `maxMs`
+// elapses. With a cycle counter the sample is the effective frequency
+// (cycles per wall second); without one it is the slice duration itself,
+// which settles once the governor stops ramping.
+inline void WarmUp(double tolerance, int maxMs, int window = 5)
+{
+    const int rounds = 1 << 22;
+    WarmUpSamples samples;
+    uint64_t sink = 1;
+
+    // Probe slice: if the cycle counter does not count here, the whole run uses slice time.
+    {
+        PerfCounters probe;
+        sink = WarmUpKernel(sink, rounds / 16);
+        PerfSample s = probe.Read();
+        samples.cycles = s.Has(PerfCycles) && s.Get(PerfCycles) > 0;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    for (;;)
+    {
+        PerfCounters counters;
+        auto sliceStart = std::chrono::steady_clock::now();
+        sink = WarmUpKernel(sink, rounds);
+        auto sliceEnd = std::chrono::steady_clock::now();
+        PerfSample s = counters.Read();
+
+        double seconds = std::chrono::duration<double>(sliceEnd - sliceStart).count();
+        if (!samples.cycles)
+            samples.values.push_back(seconds);
+        else if (s.Has(PerfCycles) && s.Get(PerfCycles) > 0)
+            samples.values.push_back(s.Get(PerfCycles) / seconds);
+        // else: the counter was multiplexed out for this slice; drop it rather than mix units
+
+        std::vector<double>& values = samples.values;
+        double elapsedMs = std::chrono::duration<double, std::milli>(sliceEnd - begin).count();
+        if ((int)values.size() >= window)
+        {
+            auto first = values.end() - window;
+            double lo = *std::min_element(first, values.end());
+            double hi = *std::max_element(first, values.end());
+            double mean = 0.0;
+            for (auto it = first; it != values.end(); ++it)
+                mean += *it / window;
+
+            if ((hi - lo) / mean <= tolerance)
+            {
+                if (samples.cycles)
+                    printf("CPU stable at %.2f GHz after %.0f ms (%zu samples).\n", mean * 1e-9, elapsedMs, values.size());
+                else
+                    printf("Loop timing stable at %.3f ms/slice after %.0f ms (%zu samples).\n", mean * 1e3, elapsedMs, values.size());
+                break;
+            }
+        }
+        if (elapsedMs >= maxMs)
+        {
+            printf("Warm-up did not stabilize within %d ms (%zu samples), continuing.\n", maxMs, values.size());
+            break;
+        }
+    }
+
+    if (sink == 0)
+        printf("\n");
+}
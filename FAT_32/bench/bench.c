@@ -0,0 +1,322 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <errno.h>
+#include <error.h>
+
+#include "fat16.h"
+#include "commands.h"
+#include "support.h"
+#include "output.h"
+
+/*
+ * Microbenchmarks dos caminhos quentes do obese32, sobre uma imagem FAT32
+ * sintética montada em memória (fmemopen): nada depende do disk.img.
+ *
+ *   obese32-bench           tabela com ns por operação
+ *   obese32-bench --train   a mesma carga, sem saída (usada pelo make pgo)
+ */
+
+#define BENCH_CLUSTERS   (256 * 1024)  // clusters de dados da imagem
+#define BENCH_FREE_TAIL  (BENCH_CLUSTERS / 64)
+#define BENCH_ROOT       512           // entradas do diretório para find_in_root/show_files
+#define BENCH_MIN_NS     200000000ull  // cada medida roda por pelo menos 0,2 s
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+/* Impede o compilador de jogar fora um resultado não usado */
+static volatile uint64_t sink;
+
+/*
+ * Barreira: o compilador passa a supor que a memória mudou, então não pode
+ * tirar do laço uma chamada pura (com LTO ele enxerga através dela).
+ */
+#define BENCH_CLOBBER() __asm__ __volatile__("" ::: "memory")
+
+///
+/// DADOS SINTÉTICOS
+
+struct bench_data
+{
+	char           *image;   // setor de boot + FATs
+	size_t          size;
+	FILE           *fp;
+	struct fat_bpb  bpb;
+	uint32_t       *fat;
+	uint32_t       *starts;  // cluster inicial de cada arquivo
+	uint32_t        files;
+	struct fat_dir  root[BENCH_ROOT + 1];
+	char            names[BENCH_ROOT][16];
+};
+
+/* xorshift: o mesmo conteúdo a cada execução, para os números serem comparáveis */
+static uint32_t bench_rand(uint32_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+/*
+ * Arquivos de 1 a 64 clusters; de vez em quando a cadeia pula um cluster,
+ * que vira um arquivo de um cluster só. Só o último 1/64 da FAT fica livre:
+ * a busca por cluster livre a partir do começo percorre a tabela quase inteira.
+ */
+static void bench_build_fat(uint32_t *fat, uint32_t **starts, uint32_t *files)
+{
+	uint32_t seed = 0x0b35e32, capacity = 1024, cluster = 2;
+	const uint32_t end = BENCH_CLUSTERS + 2 - BENCH_FREE_TAIL;
+
+	*starts = malloc(capacity * sizeof(uint32_t));
+	*files  = 0;
+
+	fat[0] = 0x0FFFFFF8;
+	fat[1] = 0x0FFFFFFF;
+
+	while (cluster < end)
+	{
+		uint32_t length = 1 + bench_rand(&seed) % 64;
+
+		if (*files == capacity)
+			*starts = realloc(*starts, (capacity *= 2) * sizeof(uint32_t));
+		(*starts)[(*files)++] = cluster;
+
+		for (uint32_t i = 1; i < length && cluster + 2 < end; i++)
+		{
+			uint32_t next = cluster + 1 + (bench_rand(&seed) % 8 == 0);
+			fat[cluster] = next;
+			if (next == cluster + 2)
+				fat[cluster + 1] = 0x0FFFFFFF; // o cluster pulado é um arquivo de um cluster
+			cluster = next;
+		}
+		fat[cluster] = 0x0FFFFFFF;
+		cluster++;
+	}
+
+	if (!*starts)
+		error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar a lista de arquivos");
+}
+
+static void bench_setup(struct bench_data *data)
+{
+	const uint32_t bps = 512, reserved = 32;
+	const uint32_t fat_sectors = (BENCH_CLUSTERS + 2) * 4 / bps + 1;
+
+	data->size  = (size_t) (reserved + 2 * fat_sectors) * bps;
+	data->image = calloc(1, data->size);
+
+	if (!data->image)
+		error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar a imagem sintética");
+
+	// SETOR DE BOOT: SÓ OS CAMPOS QUE O rfat() USA
+	struct fat_bpb *bpb = (struct fat_bpb *) data->image;
+	bpb->bytes_p_sect     = bps;
+	bpb->sector_p_clust   = 1;
+	bpb->reserved_sect    = reserved;
+	bpb->n_fat            = 2;
+	bpb->total_sectors_32 = reserved + 2 * fat_sectors + BENCH_CLUSTERS;
+	bpb->sect_per_fat_32  = fat_sectors;
+	bpb->root_cluster     = 2;
+
+	uint32_t *fat = (uint32_t *) (data->image + reserved * bps);
+	bench_build_fat(fat, &data->starts, &data->files);
+	memcpy((char *) fat + fat_sectors * bps, fat, fat_sectors * bps);
+
+	// A IMAGEM É LIDA PELO MESMO CAMINHO DE UMA IMAGEM EM DISCO
+	data->fp = fmemopen(data->image, data->size, "rb");
+	if (!data->fp)
+		error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "fmemopen");
+
+	rfat(data->fp, &data->bpb);
+	data->fat = fat_load(data->fp, &data->bpb);
+
+	// DIRETÓRIO: NOMES 8.3 NO FORMATO DO DISCO; A ÚLTIMA ENTRADA ZERADA MARCA O FIM
+	memset(data->root, 0, sizeof(data->root));
+	for (int i = 0; i < BENCH_ROOT; i++)
+	{
+		char raw[FAT16STR_SIZE_WNULL];
+		snprintf(data->names[i], sizeof(data->names[i]), "file%d.%s", i, i % 3 ? "txt" : "dat");
+		cstr_to_fat16wnull(data->names[i], raw);
+
+		memcpy(data->root[i].name, raw, FAT16STR_SIZE);
+		data->root[i].attr       = 0x20;
+		data->root[i].file_size  = (uint32_t) i * 1000;
+		data->root[i].starting_cluster = (uint16_t) data->starts[i % data->files];
+	}
+}
+
+static void bench_teardown(struct bench_data *data)
+{
+	fclose(data->fp);
+	free(data->fat);
+	free(data->starts);
+	free(data->image);
+}
+
+///
+/// MEDIDAS
+///
+/// Cada uma roda `ops` operações e retorna quantas fez; o driver repete até
+/// passar de BENCH_MIN_NS e mostra o tempo médio por operação.
+
+static uint64_t bench_find_in_root(struct bench_data *data, uint64_t ops)
+{
+	struct fat_bpb bpb = data->bpb;
+	bpb.geo.root_size = BENCH_ROOT * sizeof(struct fat_dir); // find_in_root() percorre o tamanho do raiz que ls() leria
+
+	char raw[FAT16STR_SIZE_WNULL];
+	uint64_t found = 0;
+
+	for (uint64_t i = 0; i < ops; i++)
+	{
+		// Metade das buscas é por um nome que não existe: percorre tudo
+		if (i & 1)
+			memcpy(raw, "MISSING TXT", FAT16STR_SIZE_WNULL);
+		else
+			memcpy(raw, data->root[(i * 7919) % BENCH_ROOT].name, FAT16STR_SIZE), raw[FAT16STR_SIZE] = '\0';
+
+		found += find_in_root(data->root, raw, &bpb).found;
+		BENCH_CLOBBER();
+	}
+
+	sink += found;
+	return ops;
+}
+
+static uint64_t bench_cstr_to_fat16(struct bench_data *data, uint64_t ops)
+{
+	char raw[FAT16STR_SIZE_WNULL];
+	uint64_t acc = 0;
+
+	for (uint64_t i = 0; i < ops; i++)
+	{
+		cstr_to_fat16wnull(data->names[i % BENCH_ROOT], raw);
+		acc += (unsigned char) raw[3];
+		BENCH_CLOBBER();
+	}
+
+	sink += acc;
+	return ops;
+}
+
+/* Uma operação = um passo na cadeia */
+static uint64_t bench_chain_walk(struct bench_data *data, uint64_t ops)
+{
+	uint64_t steps = 0;
+
+	for (uint32_t f = 0; steps < ops; f = (f + 1) % data->files)
+	{
+		for (uint32_t c = data->starts[f]; c < FAT32_EOC; c = fat_next_cluster(data->fat, &data->bpb, c))
+			steps++;
+		BENCH_CLOBBER();
+	}
+
+	sink += steps;
+	return steps;
+}
+
+/* Uma operação = uma busca a partir do cluster 2, que acha o primeiro livre lá no fim */
+static uint64_t bench_find_free(struct bench_data *data, uint64_t ops)
+{
+	uint64_t acc = 0;
+
+	for (uint64_t i = 0; i < ops; i++)
+	{
+		acc += fat_find_free(data->fat, &data->bpb, 2);
+		BENCH_CLOBBER();
+	}
+
+	sink += acc;
+	return ops;
+}
+
+/* Uma operação = uma listagem de BENCH_ROOT entradas, escrita em /dev/null */
+static uint64_t bench_show_files(struct bench_data *data, uint64_t ops)
+{
+	fflush(stdout);
+	int saved = dup(STDOUT_FILENO);
+	int null  = open("/dev/null", O_WRONLY);
+
+	if (saved < 0 || null < 0)
+		error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "/dev/null");
+	dup2(null, STDOUT_FILENO);
+
+	for (uint64_t i = 0; i < ops; i++)
+		show_files(data->root);
+
+	fflush(stdout);
+	dup2(saved, STDOUT_FILENO);
+	close(saved);
+	close(null);
+
+	return ops;
+}
+
+struct bench
+{
+	const char *name;
+	const char *unit;
+	uint64_t  (*run)(struct bench_data *, uint64_t ops);
+	uint64_t    train_ops; // carga do --train
+};
+
+static const struct bench benches[] =
+{
+	{ "find_in_root",       "busca",    bench_find_in_root,  200000   },
+	{ "cstr_to_fat16wnull", "nome",     bench_cstr_to_fat16, 2000000  },
+	{ "chain_walk",         "cluster",  bench_chain_walk,    20000000 },
+	{ "fat_find_free",      "busca",    bench_find_free,     200      },
+	{ "show_files",         "listagem", bench_show_files,    2000     },
+};
+
+int main(int argc, char **argv)
+{
+	bool train = argc > 1 && strcmp(argv[1], "--train") == 0;
+	struct bench_data data;
+
+	bench_setup(&data);
+
+	if (!train)
+		printf("%-20s %12s %12s  %s\n", "benchmark", "ops", "ns/op", "(op)");
+
+	for (size_t b = 0; b < sizeof(benches) / sizeof(benches[0]); b++)
+	{
+		const struct bench *bench = &benches[b];
+
+		if (train)
+		{
+			bench->run(&data, bench->train_ops);
+			continue;
+		}
+
+		// DOBRA A CARGA ATÉ A MEDIDA DURAR O SUFICIENTE
+		uint64_t ops = 1, done = 0, elapsed = 0;
+		for (;;)
+		{
+			uint64_t start = now_ns();
+			done    = bench->run(&data, ops);
+			elapsed = now_ns() - start;
+
+			if (elapsed >= BENCH_MIN_NS)
+				break;
+			ops *= 2;
+		}
+
+		printf("%-20s %12llu %12.2f  (%s)\n", bench->name, (unsigned long long) done,
+		       (double) elapsed / (double) done, bench->unit);
+	}
+
+	bench_teardown(&data);
+	return EXIT_SUCCESS;
+}
@@ -15,17 +15,6 @@ struct far_dir_searchres
 	int             idx; // Index relativo ao diretório de busca
 };
 
-/*
- * Esta struct encapsula o resultado de fat16_find_free_cluster()
- *
- */
-struct fat16_newcluster_info
-{
-	uint16_t cluster;
-	uint32_t address;
-};
-
-
 /* list files in fat_bpb */
 struct fat_dir *ls(FILE *, struct fat_bpb *);
 
@@ -33,24 +22,44 @@ struct fat_dir *ls(FILE *, struct fat_bpb *);
 /* move um arquivo da fonte ao destino */
 void mv(FILE* fp, char* source, char* dest, struct fat_bpb* bpb);
 
-/* delete the file from the fat directory */
-void rm(FILE* fp, char* filename, struct fat_bpb* bpb);
+/*
+ * Remove o arquivo do diretório e libera a cadeia de clusters na FAT (todas
+ * as cópias de uma vez). Com `punch`, os clusters liberados viram furos na
+ * imagem do host (fallocate), quando ela é um arquivo comum.
+ */
+void rm(FILE* fp, char* filename, struct fat_bpb* bpb, bool punch);
 
 /* copy the file to the fat directory */
 void cp(FILE* fp, char* source, char* dest, struct fat_bpb* bpb);
 
 /*
- * Esta função escreve no terminal os conteúdos de um arquivo.
+ * Esta função escreve no terminal os conteúdos de um arquivo, a partir de
+ * `offset` e por até `length` bytes (CAT_TO_END = até o fim).
  */
-void cat(FILE* fp, char* filename, struct fat_bpb* bpb);
+void cat(FILE* fp, char* filename, struct fat_bpb* bpb, uint64_t offset, uint64_t length);
+
+#define CAT_TO_END UINT64_MAX
+
+/* Opções do hashsum */
+struct hashsum_opts
+{
+	bool sha256;  // acrescenta o SHA-256 de cada arquivo
+	bool dups;    // mostra só arquivos com conteúdo repetido
+	int  threads; // 0 = uma por CPU
+};
+
+/*
+ * Calcula o CRC32C (e opcionalmente o SHA-256) de todos os arquivos direto
+ * das cadeias de clusters, em paralelo. Saída ordenada, separada por tabs:
+ * crc32c [sha256] tamanho caminho
+ */
+void hashsum(FILE* fp, struct fat_bpb* bpb, struct hashsum_opts* opts);
 
 /* helper function: find specific filename in fat_dir */
 struct far_dir_searchres find_in_root(struct fat_dir *dirs, char *filename, struct fat_bpb *bpb);
 
-/* Procura cluster vazio */
-struct fat16_newcluster_info fat16_find_free_cluster(FILE* fp, struct fat_bpb* bpb);
-
 #define MIN(X, Y) (((X) < (Y)) ? (X) : (Y))
+#define MAX(X, Y) (((X) > (Y)) ? (X) : (Y))
 
 ///
 
@@ -0,0 +1,35 @@
+#ifndef CONTAINER_H
+#define CONTAINER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/*
+ * Contêiner comprimido e endereçável: a imagem é dividida em pedaços
+ * (chunks) de CONTAINER_CHUNK bytes, cada um comprimido com zlib em separado,
+ * e um índice no fim do arquivo diz onde cada chunk comprimido está.
+ *
+ * Layout:
+ *   [cabeçalho][chunk 0][chunk 1]...[índice: offset e tamanho de cada chunk]
+ *
+ * Só os chunks que um comando toca são descomprimidos, e ficam num cache LRU
+ * de CONTAINER_CACHE chunks. Leituras grandes descomprimem os chunks que
+ * faltam em paralelo. Chunks alterados são recomprimidos e acrescentados no
+ * fim do arquivo ao fechar, seguidos de um índice novo; o cabeçalho só passa
+ * a apontar para ele depois que tudo foi gravado.
+ */
+
+#define CONTAINER_CHUNK (64 * 1024)
+#define CONTAINER_CACHE 64
+
+/* O arquivo começa com a assinatura de um contêiner? */
+bool container_detect(const char *path);
+
+/* Abre o contêiner como um FILE* com a imagem descomprimida */
+FILE *container_open(const char *path);
+
+/* Cria um contêiner a partir de uma imagem crua, e o contrário */
+void container_pack(const char *image_path, const char *container_path);
+void container_unpack(const char *container_path, const char *image_path);
+
+#endif
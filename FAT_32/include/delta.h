@@ -0,0 +1,39 @@
+#ifndef DELTA_H
+#define DELTA_H
+
+#include <stdio.h>
+#include "fat16.h"
+
+/*
+ * Diferença e sincronização entre duas imagens com a mesma geometria.
+ *
+ * A comparação é feita por setor nos metadados (setor de boot, FSInfo, FATs,
+ * raiz fixo) e por cluster na área de dados, mas só nos clusters ocupados na
+ * imagem de origem: um cluster livre lá não precisa ser copiado. O custo é
+ * proporcional aos dados em uso, e o delta ao que mudou.
+ *
+ * Formato do delta:
+ *   [cabeçalho][registro][dados]...[registro][dados]
+ *
+ * Cada registro diz onde o trecho fica na imagem, e o CRC32C do trecho antes
+ * (na base) e depois (nos dados que o seguem). apply confere todas as bases
+ * antes de escrever o primeiro byte, e grava a área de dados antes dos
+ * metadados: uma interrupção no meio não deixa a FAT apontando para lixo.
+ */
+
+#define DELTA_CHUNK (256 * 1024) // maior trecho lido (e gravado) de uma vez
+
+/*
+ * Compara `fp` com a imagem em `other_path`. Sem `delta_path` lista os
+ * arquivos adicionados (A), alterados (M) e removidos (D) em `other_path`;
+ * com ele, grava o delta que transforma `fp` em `other_path`.
+ */
+void image_diff(FILE *fp, struct fat_bpb *bpb, const char *other_path, const char *delta_path);
+
+/* Aplica em `fp` um delta criado com image_diff() */
+void image_apply(FILE *fp, struct fat_bpb *bpb, const char *delta_path);
+
+/* Deixa `fp` igual à imagem em `source_path`, gravando só o que mudou */
+void image_sync(FILE *fp, struct fat_bpb *bpb, const char *source_path);
+
+#endif
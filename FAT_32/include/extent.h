@@ -0,0 +1,56 @@
+#ifndef EXTENT_H
+#define EXTENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "fat16.h"
+
+/*
+ * Mapa de extents de um arquivo: a cadeia de clusters resumida em trechos de
+ * clusters consecutivos, em ordem de offset no arquivo. Com ele uma leitura
+ * em qualquer offset acha o cluster certo por busca binária, em vez de
+ * seguir a cadeia desde o começo.
+ *
+ * O cache vive no processo: só quem faz várias leituras na mesma execução
+ * ganha o acesso direto. Cada execução do obese32 carrega a FAT e monta o
+ * mapa do arquivo de novo.
+ */
+struct fat_extent
+{
+	uint64_t offset;  // offset no arquivo onde o trecho começa
+	uint32_t cluster; // primeiro cluster do trecho
+	uint32_t count;   // clusters consecutivos
+};
+
+struct fat_extent_map
+{
+	uint32_t start_cluster;
+	uint32_t file_size;
+	size_t   count;
+	struct fat_extent *extents;
+};
+
+/*
+ * Mapa do arquivo da entrada, montado na primeira vez e depois reaproveitado.
+ * O ponteiro vale até a próxima invalidação do cache.
+ */
+const struct fat_extent_map *extent_map_get(FILE *fp, struct fat_bpb *bpb, const struct fat_dir *entry);
+
+/* FAT em memória usada pelo cache (carregada na primeira chamada) */
+const uint32_t *extent_cache_fat(FILE *fp, struct fat_bpb *bpb);
+
+/*
+ * Esquece o mapa de um arquivo (ou todos, e a FAT em cache, com cluster 0).
+ * Chame com 0 antes de fechar a imagem: o cache é identificado pelo FILE*, e
+ * uma imagem aberta depois pode receber o mesmo endereço.
+ */
+void extent_cache_invalidate(uint32_t start_cluster);
+
+/*
+ * Lê até `len` bytes do arquivo a partir de `offset`. Retorna quantos bytes
+ * foram lidos: menos que `len` só no fim do arquivo ou de uma cadeia curta.
+ */
+size_t fat_read_at(FILE *fp, struct fat_bpb *bpb, const struct fat_dir *entry, uint64_t offset, void *buf, size_t len);
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <stdbool.h>
 
 #define DIR_FREE_ENTRY 0xE5
 
@@ -16,6 +17,26 @@
 
 #define SIG 0xAA55 /* boot sector signature -- sector is executable */
 
+struct fat_engine;
+
+/*
+ * Geometria do volume, calculada uma única vez por rfat() a partir do BPB.
+ * Não faz parte do setor de boot: rfat() lê só os campos anteriores a ela.
+ */
+struct fat_geometry {
+	const struct fat_engine *engine; /* FAT12, FAT16 ou FAT32 (ver fat_engine.h) */
+	uint32_t fat_addr;      /* início da primeira cópia da FAT */
+	uint32_t fat_sectors;   /* setores por cópia */
+	uint8_t  fat_first;     /* primeira cópia ativa */
+	uint8_t  fat_copies;    /* cópias ativas (1 com o espelhamento desligado) */
+	uint32_t root_addr;     /* diretório raiz (fixo em FAT12/16) */
+	uint32_t root_size;     /* bytes do raiz fixo; 0 em FAT32 */
+	uint32_t data_addr;     /* início da área de dados (cluster 2) */
+	uint32_t cluster_width; /* bytes por cluster */
+	uint32_t cluster_count; /* clusters de dados */
+	uint32_t entry_count;   /* entradas válidas da FAT: cluster_count + 2 */
+};
+
 #pragma pack(push, 1)
 struct fat_dir {
 	unsigned char name[11]; /* Short name + file extension */
@@ -25,7 +46,7 @@ struct fat_dir {
 	uint16_t creation_time; /* time file was created */
 	uint16_t ctreation_date; /* date file was created */
 	uint16_t last_access_date; /* last access date (last read/written) */
-	uint16_t reserved_fat32; /* reserved for fat32 */
+	uint16_t starting_cluster_hi; /* high 16 bits of the starting cluster (FAT32) */
 	uint16_t last_write_time; /* time of last write */
 	uint16_t last_write_date; /* date of last write */
 	uint16_t starting_cluster; /* starting cluster */
@@ -54,12 +75,16 @@ struct fat_bpb {
     uint32_t hidden_sects;           // Setores ocultos
     uint32_t total_sectors_32;       // Número total de setores (usado se total_sectors_16 for zero)
     uint32_t sect_per_fat_32;        // Setores por FAT em FAT32
+    uint16_t ext_flags;              // Espelhamento da FAT (bit 7 = só uma FAT ativa)
+    uint16_t fs_version;             // Versão do FAT32 (0.0)
 
     uint32_t root_cluster;           // Cluster inicial do diretório raiz em FAT32 (masked with FAT32_CLUSTER_MASK)
     uint16_t fs_info;                // Setor de informações do sistema de arquivos
     uint16_t backup_boot_sector;     // Setor de backup do setor de boot
 
     uint8_t reserved[12];            // Reservado para uso futuro
+
+    struct fat_geometry geo;         // Calculada por rfat(), não vem do disco
 };
 /*
  * NOTE - Modificação
@@ -68,7 +93,7 @@ struct fat_bpb {
  */
 #pragma pack(pop)
 
-int read_bytes(FILE *, unsigned int, void *, unsigned int);
+int read_bytes(FILE *, uint64_t, void *, unsigned int);
 void rfat(FILE *, struct fat_bpb *);
 
 /* prototypes for calculating fat stuff */
@@ -77,6 +102,45 @@ uint32_t bpb_froot_addr(struct fat_bpb *);
 uint32_t bpb_fdata_addr(struct fat_bpb *);
 uint32_t bpb_fdata_sector_count(struct fat_bpb *);
 uint32_t bpb_fdata_cluster_count(struct fat_bpb* bpb);
+uint32_t bpb_total_sectors(struct fat_bpb *);
+uint64_t bpb_cluster_addr(struct fat_bpb *, uint32_t cluster);
+
+/*
+ * Tabela inteira em memória e cadeias de clusters. Seja qual for a variante,
+ * a FAT em memória tem entradas de 32 bits no formato FAT32: fim de cadeia
+ * >= FAT32_EOC e FAT32_BAD para cluster ruim.
+ */
+uint32_t *fat_load(FILE *, struct fat_bpb *);
+uint32_t fat_entry_count(struct fat_bpb *);
+uint32_t fat_next_cluster(const uint32_t *fat, struct fat_bpb *, uint32_t cluster);
+uint32_t fat_dir_cluster(const struct fat_dir *);
+
+/* Primeiro cluster livre a partir de `from` (dando a volta), ou 0 se a FAT está cheia */
+uint32_t fat_find_free(const uint32_t *fat, struct fat_bpb *, uint32_t from);
+
+/*
+ * Percorre recursivamente os diretórios a partir da raiz, chamando `visit`
+ * para cada arquivo e subdiretório. `path` é o caminho com '/' entre os
+ * nomes 8.3 já formatados ("DIR/ARQ.TXT") e `address` é onde a entrada está
+ * na imagem, para quem precisar reescrevê-la.
+ */
+typedef void (*fat_visit_fn)(const char *path, const struct fat_dir *entry, uint64_t address, void *arg);
+void fat_walk(FILE *, struct fat_bpb *, const uint32_t *fat, fat_visit_fn visit, void *arg);
+
+/*
+ * Grava as entradas `clusters[0..count)` da FAT em memória em todas as
+ * cópias ativas na imagem, juntando setores vizinhos em uma escrita só.
+ */
+void fat_store(FILE *, struct fat_bpb *, const uint32_t *fat, const uint32_t *clusters, size_t count);
+
+/* Ajusta o FSInfo: soma `free_delta` aos clusters livres e sugere `next_free` */
+void fsinfo_update(FILE *, struct fat_bpb *, int64_t free_delta, uint32_t next_free);
+
+/* Endereço da primeira entrada livre do diretório raiz, ou false se ele está cheio */
+bool fat_root_free_entry(FILE *, struct fat_bpb *, const uint32_t *fat, uint64_t *address);
+
+/* Procura pelo caminho ("DIR/ARQ.TXT", sem diferenciar maiúsculas); address pode ser NULL */
+bool fat_find(FILE *, struct fat_bpb *, const uint32_t *fat, const char *path, struct fat_dir *entry, uint64_t *address);
 
 ///
 
@@ -86,8 +150,10 @@ uint32_t bpb_fdata_cluster_count(struct fat_bpb* bpb);
 #define RB_ERROR -1
 #define RB_OK     0
 
-#define FAT16_EOF_LO 0xfff8
-#define FAT16_EOF_HI 0xffff
 #define FAT32_CLUSTER_MASK 0x0FFFFFFF
+#define FAT32_EOC          0x0FFFFFF8 /* >= isto: fim da cadeia */
+#define FAT32_BAD          0x0FFFFFF7
+
+#define FAT_PATH_MAX 256
 
 #endif
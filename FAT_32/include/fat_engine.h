@@ -0,0 +1,41 @@
+#ifndef FAT_ENGINE_H
+#define FAT_ENGINE_H
+
+#include <stdint.h>
+#include "fat16.h"
+
+/*
+ * Acesso às entradas da FAT de uma variante (12, 16 ou 32 bits). Cada motor é
+ * gerado pela mesma macro com largura, máscara e faixas de fim de cadeia
+ * constantes, então os laços de conversão não testam a variante por entrada.
+ *
+ * A FAT em memória está sempre no formato FAT32 (ver fat_load()): `decode`
+ * converte da largura em disco para ele e `encode` grava uma entrada de volta.
+ */
+struct fat_engine
+{
+	uint8_t  bits;    // largura de uma entrada em disco
+	uint32_t mask;    // bits que formam o número do cluster
+	uint32_t eoc_min; // >= isto: fim de cadeia (valor em disco)
+	uint32_t bad;     // cluster ruim (valor em disco)
+
+	void (*decode)(const uint8_t *raw, uint32_t *fat, uint32_t count);
+	void (*encode)(uint8_t *raw, uint32_t cluster, uint32_t value);
+};
+
+extern const struct fat_engine fat12_engine;
+extern const struct fat_engine fat16_engine;
+extern const struct fat_engine fat32_engine;
+
+/* Bytes da FAT em disco onde a entrada de `cluster` começa e termina */
+static inline uint32_t fat_entry_first_byte(const struct fat_engine *engine, uint32_t cluster)
+{
+	return (uint32_t) ((uint64_t) cluster * engine->bits / 8);
+}
+
+static inline uint32_t fat_entry_last_byte(const struct fat_engine *engine, uint32_t cluster)
+{
+	return (uint32_t) (((uint64_t) cluster * engine->bits + engine->bits - 1) / 8);
+}
+
+#endif
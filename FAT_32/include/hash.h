@@ -0,0 +1,28 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * CRC32C (Castagnoli). Usa a instrução crc32 do SSE4.2 quando a CPU tem,
+ * senão uma tabela. Encadeável: crc32c(crc32c(0, a), b) == crc32c(0, a+b).
+ */
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+
+/* SHA-256, para quando um CRC não basta (ex.: achar duplicatas) */
+struct sha256_ctx
+{
+	uint32_t state[8];
+	uint64_t length;   // bytes processados
+	uint8_t  block[64];
+	size_t   used;     // bytes em block
+};
+
+#define SHA256_DIGEST_SIZE 32
+
+void sha256_init(struct sha256_ctx *ctx);
+void sha256_update(struct sha256_ctx *ctx, const void *buf, size_t len);
+void sha256_final(struct sha256_ctx *ctx, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include <stdio.h>
+
+/*
+ * Overlay copy-on-write: a imagem base é aberta somente para leitura e toda
+ * escrita vai para um arquivo esparso à parte, em blocos de OVERLAY_BLOCK
+ * bytes. Um bitmap no cabeçalho do overlay diz quais blocos foram alterados.
+ *
+ * Layout do overlay:
+ *   [cabeçalho][bitmap, 1 bit por bloco][alinhamento][bloco 0][bloco 1]...
+ * O bloco i fica sempre no mesmo lugar; blocos nunca escritos são buracos.
+ */
+
+#define OVERLAY_BLOCK 512
+
+/* Abre base+overlay como um único FILE* (criando o overlay se preciso) */
+FILE *overlay_open(const char *base_path, const char *overlay_path);
+
+/* Descarta todas as alterações: trunca o overlay */
+void overlay_reset(const char *overlay_path);
+
+/* Aplica os blocos alterados na imagem base e esvazia o overlay */
+void overlay_commit(const char *base_path, const char *overlay_path);
+
+#endif
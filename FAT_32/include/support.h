@@ -2,8 +2,16 @@
 #define SUPPORT_H
 
 #include <stdbool.h>
+#include <sys/types.h>
 #include "fat16.h"
 
 bool cstr_to_fat16wnull(char *filename, char output[FAT16STR_SIZE_WNULL]);
 
+/*
+ * pread/pwrite que só retornam com tudo transferido; erro de E/S aborta.
+ * Ler além do fim do arquivo preenche o resto com zeros (arquivos esparsos).
+ */
+void full_pread(int fd, void *buf, size_t len, off_t offset);
+void full_pwrite(int fd, const void *buf, size_t len, off_t offset);
+
 #endif
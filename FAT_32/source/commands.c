@@ -1,11 +1,15 @@
+#define _GNU_SOURCE
 #include <unistd.h>
+#include <fcntl.h>
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <stdbool.h>
 #include "commands.h"
 #include "fat16.h"
 #include "support.h"
+#include "extent.h"
 
 #include <errno.h>
 #include <err.h>
@@ -14,17 +18,24 @@
 
 #include <sys/types.h>
 
+/* Bytes do raiz que ls() lê: a região fixa (FAT12/16) ou o primeiro cluster (FAT32) */
+static uint32_t root_read_size(struct fat_bpb *bpb)
+{
+    return bpb->geo.root_size ? bpb->geo.root_size : bpb->geo.cluster_width;
+}
+
 /*
  * Função para realizar a busca na pasta raiz.
- * A função percorre todas as bpb->possible_rentries no struct fat_dir* dirs
- * e retorna a primeira entrada cujo nome corresponde ao filename.
+ * A função percorre as entradas que ls() leu no struct fat_dir* dirs, até a
+ * entrada que marca o fim, e retorna a primeira cujo nome corresponde ao filename.
  */
 
 struct far_dir_searchres find_in_root(struct fat_dir* root, char* filename, struct fat_bpb* bpb)
 {
-    struct far_dir_searchres result = { .found = false, .fdir = NULL, .idx = 0 };
+    struct far_dir_searchres result = { .found = false, .idx = 0 };
+    uint32_t entries = root_read_size(bpb) / sizeof(struct fat_dir);
 
-    for (uint32_t i = 0; i < bpb->root_entry_count; i++)
+    for (uint32_t i = 0; i < entries && root[i].name[0] != 0; i++)
     {
         if (strncmp((char*)root[i].name, filename, FAT16STR_SIZE) == 0)
         {
@@ -45,25 +56,18 @@ struct far_dir_searchres find_in_root(struct fat_dir* root, char* filename, stru
 
 struct fat_dir *ls(FILE *fp, struct fat_bpb *bpb)
 {
-    // Verifica se é FAT32
-    if (bpb->sect_per_fat_16 != 0) {
-        error_at_line(EXIT_FAILURE, EINVAL, __FILE__, __LINE__, "O sistema de arquivos não é FAT32");
-        return NULL;
-    }
-
-    // Calcula o endereço do diretório raiz
-    uint32_t root_cluster = bpb->root_cluster & FAT32_CLUSTER_MASK;
-    uint32_t root_address = bpb_fdata_addr(bpb) + (root_cluster - 2) * bpb->sector_p_clust * bpb->bytes_p_sect;
+    // Raiz fixo (FAT12/16) ou o primeiro cluster do raiz (FAT32)
+    uint32_t root_address = bpb_froot_addr(bpb);
+    uint32_t root_size = root_read_size(bpb);
 
-    // Tenta ler o diretório raiz (Tamanho de um cluster, por exemplo)
-    uint32_t cluster_size = bpb->sector_p_clust * bpb->bytes_p_sect;
-    struct fat_dir *dirs = malloc(cluster_size);
+    // Uma entrada zerada a mais marca o fim para show_files()
+    struct fat_dir *dirs = calloc(1, root_size + sizeof(struct fat_dir));
 
     if (!dirs) {
         error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar memória para o diretório");
     }
 
-    if (read_bytes(fp, root_address, dirs, cluster_size) == RB_ERROR) {
+    if (read_bytes(fp, root_address, dirs, root_size) == RB_ERROR) {
         free(dirs);
         error_at_line(EXIT_FAILURE, EIO, __FILE__, __LINE__, "Erro ao ler struct fat_dir");
     }
@@ -73,55 +77,54 @@ struct fat_dir *ls(FILE *fp, struct fat_bpb *bpb)
 
 void mv(FILE *fp, char *source, char* dest, struct fat_bpb *bpb)
 {
-    char source_rname[FAT16STR_SIZE_WNULL], dest_rname[FAT16STR_SIZE_WNULL];
+    // O DESTINO É UM NOVO NOME NO DIRETÓRIO DA ORIGEM; UM CAMINHO SÓ SE FOR O MESMO DIRETÓRIO
+    const char *source_slash = strrchr(source, '/');
+    const char *dest_slash = strrchr(dest, '/');
+    size_t dir_len = source_slash ? (size_t) (source_slash - source) : 0;
+    char *dest_name = dest_slash ? (char *) dest_slash + 1 : dest;
 
-    // FORMATAÇÃO DOS NOMES
-    bool badname = cstr_to_fat16wnull(source, source_rname) || cstr_to_fat16wnull(dest, dest_rname);
+    if (dest_slash && ((size_t) (dest_slash - dest) != dir_len || strncasecmp(source, dest, dir_len) != 0))
+        error(EXIT_FAILURE, 0, "mv só renomeia dentro do mesmo diretório.");
 
-    if (badname)
+    // FORMATAÇÃO DO NOME
+    char dest_rname[FAT16STR_SIZE_WNULL], dest_path[FAT_PATH_MAX];
+
+    if (cstr_to_fat16wnull(dest_name, dest_rname))
     {
         fprintf(stderr, "Nome de arquivo inválido.\n");
         exit(EXIT_FAILURE);
     }
+    snprintf(dest_path, sizeof(dest_path), "%.*s%s%s", (int) dir_len, source, dir_len ? "/" : "", dest_name);
 
-    // CALCULO DE TAMANHO E ENDEREÇO DO DIRETÓRIO RAIZ
-    uint32_t root_address = bpb_froot_addr(bpb);
-    uint32_t root_size = sizeof(struct fat_dir) * bpb->root_entry_count;
-
-    // LEITURA DO DIRETÓRIO RAIZ
-    struct fat_dir root[root_size];
-    if (read_bytes(fp, root_address, &root, root_size) == RB_ERROR)
-    {
-        error_at_line(EXIT_FAILURE, EIO, __FILE__, __LINE__, "erro ao ler struct fat_dir");
-    }
+    // BUSCA DOS ARQUIVOS PELO CAMINHO; source_address É ONDE ESTÁ A ENTRADA
+    uint32_t *fat = fat_load(fp, bpb);
+    struct fat_dir source_entry, dest_entry;
+    uint64_t source_address;
 
-    // BUSCA DOS ARQUIVOS
-    struct far_dir_searchres dir1 = find_in_root(root, source_rname, bpb);
-    struct far_dir_searchres dir2 = find_in_root(root, dest_rname, bpb);
+    bool dest_found = fat_find(fp, bpb, fat, dest_path, &dest_entry, NULL);
+    bool source_found = fat_find(fp, bpb, fat, source, &source_entry, &source_address);
+    free(fat);
 
     // VERIFICAÇÕES DE EXISTENCIA DE ARQUIVO/ARQUIVO ORIGEM
-    if (dir2.found == true)
+    if (dest_found)
     {
         error(EXIT_FAILURE, 0, "Não permitido substituir arquivo %s via mv.", dest);
     }
-    if (dir1.found == false)
+    if (!source_found)
     {
         error(EXIT_FAILURE, 0, "Não foi possivel encontrar o arquivo %s.", source);
     }
 
     //RENAME ARQUIVO ORIGEM
-    memcpy(dir1.fdir.name, dest_rname, sizeof(char) * FAT16STR_SIZE);
+    memcpy(source_entry.name, dest_rname, sizeof(char) * FAT16STR_SIZE);
 
-    //CALCULO ENDEREÇO DE ENTRADA DO DIRETÓRIO
-    uint32_t source_address = root_address + dir1.idx * sizeof(struct fat_dir);
-
-    // ESCREVER NO DISCO 
-    if (fseek(fp, source_address, SEEK_SET) != 0)
+    // ESCREVER NO DISCO
+    if (fseek(fp, (long) source_address, SEEK_SET) != 0)
     {
         error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao posicionar o ponteiro do arquivo");
     }
 
-    if (fwrite(&dir1.fdir, sizeof(struct fat_dir), 1, fp) != 1)
+    if (fwrite(&source_entry, sizeof(struct fat_dir), 1, fp) != 1)
     {
         error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao escrever a entrada do diretório");
     }
@@ -129,281 +132,233 @@ void mv(FILE *fp, char *source, char* dest, struct fat_bpb *bpb)
     printf("mv %s → %s.\n", source, dest);
 }
 
-void rm(FILE* fp, char* filename, struct fat_bpb* bpb)
+void rm(FILE* fp, char* filename, struct fat_bpb* bpb, bool punch)
 {
-    char fat16_rname[FAT16STR_SIZE_WNULL];
+    // BUSCA DO ARQUIVO PELO CAMINHO; address É ONDE ESTÁ A ENTRADA
+    uint32_t *fat = fat_load(fp, bpb);
+    struct fat_dir entry;
+    uint64_t address;
 
-    // FORMATAÇÃO DE NOMES
-    if (cstr_to_fat16wnull(filename, fat16_rname))
+    if (!fat_find(fp, bpb, fat, filename, &entry, &address))
     {
-        fprintf(stderr, "Nome de arquivo inválido.\n");
-        exit(EXIT_FAILURE);
+        fprintf(stderr, "Arquivo não encontrado.\n");
+        free(fat);
+        return;
     }
 
-    //DETERMINAÇÃO ENDEREÇO DIRETÓRIO RAIZ E TAMANHO
-    uint32_t root_address = bpb_froot_addr(bpb);
-    uint32_t root_size = sizeof(struct fat_dir) * bpb->root_entry_count;
+    if (entry.attr & DIR_ATTR_DIRECTORY)
+        error(EXIT_FAILURE, 0, "%s é um diretório.", filename);
+
+    // LIBERAÇÃO DA CADEIA NA FAT EM MEMÓRIA; UMA ENTRADA JÁ ZERADA ENCERRA UM CICLO
+    uint32_t *freed = NULL;
+    size_t count = 0, capacity = 0;
+    uint32_t lowest = UINT32_MAX;
 
-    // LEITURA DO DIRETÓRIO RAIZ
-    struct fat_dir root[root_size];
-    if (read_bytes(fp, root_address, &root, root_size) == RB_ERROR)
+    for (uint32_t cluster = fat_dir_cluster(&entry); cluster >= 2 && cluster < fat_entry_count(bpb);)
     {
-        error_at_line(EXIT_FAILURE, EIO, __FILE__, __LINE__, "erro ao ler struct fat_dir");
-    }
+        uint32_t next = fat[cluster] & FAT32_CLUSTER_MASK;
+        if (next == 0 || next == FAT32_BAD)
+            break;
+
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            freed = realloc(freed, capacity * sizeof(uint32_t));
+            if (!freed)
+                error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar a lista de clusters");
+        }
 
-    // BUSCA DO ARQUIVO
-    struct far_dir_searchres dir = find_in_root(&root[0], fat16_rname, bpb);
+        // Os 4 bits altos da entrada são reservados e ficam como estão
+        fat[cluster] &= ~FAT32_CLUSTER_MASK;
+        freed[count++] = cluster;
+        lowest = MIN(lowest, cluster);
 
-    // VERIFICAÇÃO DE EXISTENCIA DO ARQUIVO
-    if (dir.found == false)
-    {
-        fprintf(stderr, "Arquivo não encontrado.\n");
-        return;
+        cluster = next;
     }
 
     // MARCAÇÃO DE ENTRADA DE DIRETÓRIO COMO LIVRE
-    dir.fdir.name[0] = DIR_FREE_ENTRY;
-
-    // CALCULO ENDEREÇO DE ENTRADA DIRETÓRIO
-    uint32_t file_address = root_address + dir.idx * sizeof(struct fat_dir);
+    entry.name[0] = DIR_FREE_ENTRY;
 
-    // ESCRITA NO DISCO
-    if (fseek(fp, file_address, SEEK_SET) != 0)
-    {
+    if (fseek(fp, (long) address, SEEK_SET) != 0)
         error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao posicionar o ponteiro do arquivo");
-    }
 
-    if (fwrite(&dir.fdir, sizeof(struct fat_dir), 1, fp) != 1)
-    {
+    if (fwrite(&entry, sizeof(struct fat_dir), 1, fp) != 1)
         error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao escrever a entrada do diretório");
-    }
 
-    printf("Arquivo %s removido.\n", filename);
-}
+    // ESCRITA DA FAT: SÓ OS SETORES ALTERADOS, EM TODAS AS CÓPIAS
+    fat_store(fp, bpb, fat, freed, count);
+    fsinfo_update(fp, bpb, (int64_t) count, lowest);
+    extent_cache_invalidate(0);
 
-struct fat16_newcluster_info fat16_find_free_cluster(FILE* fp, struct fat_bpb* bpb)
-{
-    uint16_t cluster = 0x0;
-    uint32_t fat_address = bpb_faddress(bpb);
-    uint32_t total_clusters = bpb_fdata_cluster_count(bpb);
-
-    for (cluster = 0x2; cluster < total_clusters; cluster++)
+    // FUROS NA IMAGEM: UM fallocate POR TRECHO DE CLUSTERS CONSECUTIVOS
+    if (punch && count > 0)
     {
-        uint32_t entry_address = fat_address + cluster * sizeof(uint16_t);
-        uint16_t entry;
+        const uint64_t cluster_width = (uint64_t) bpb->bytes_p_sect * bpb->sector_p_clust;
+        int fd = fileno(fp);
 
-        if (read_bytes(fp, entry_address, &entry, sizeof(uint16_t)) == RB_ERROR)
-        {
-            error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao ler a entrada da FAT");
-        }
+        if (fflush(fp) != 0)
+            error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao gravar a imagem");
+
+        if (fd < 0)
+            error(0, 0, "aviso: --punch ignorado, a imagem não é um arquivo comum (overlay ou contêiner)");
 
-        if (entry == 0x0)
+        for (size_t i = 0; fd >= 0 && i < count;)
         {
-            return (struct fat16_newcluster_info) { .cluster = cluster, .address = entry_address };
+            size_t j = i + 1;
+            while (j < count && freed[j] == freed[j - 1] + 1)
+                j++;
+
+            if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                          (off_t) bpb_cluster_addr(bpb, freed[i]), (off_t) ((j - i) * cluster_width)) != 0)
+            {
+                error(0, errno, "aviso: não foi possível liberar os blocos da imagem");
+                break;
+            }
+
+            i = j;
         }
     }
 
-    return (struct fat16_newcluster_info) { .cluster = 0, .address = 0 };
+    printf("Arquivo %s removido, %zu clusters liberados.\n", filename, count);
+
+    free(freed);
+    free(fat);
 }
 
+#define CP_BUFFER (64 * 1024)
+
 void cp(FILE *fp, char* source, char* dest, struct fat_bpb *bpb)
 {
-     char source_rname[FAT16STR_SIZE_WNULL], dest_rname[FAT16STR_SIZE_WNULL];
-
-    // FORMATAÇÃO DOS NOMES
-    bool badname = cstr_to_fat16wnull(source, source_rname) || cstr_to_fat16wnull(dest, dest_rname);
+    char dest_rname[FAT16STR_SIZE_WNULL];
 
-    if (badname)
+    // FORMATAÇÃO DO NOME (O DESTINO FICA NO DIRETÓRIO RAIZ)
+    if (cstr_to_fat16wnull(dest, dest_rname))
     {
         fprintf(stderr, "Nome de arquivo inválido.\n");
         exit(EXIT_FAILURE);
     }
 
-    // CALCULO DE TAMANHO E ENDEREÇO DO DIRETÓRIO RAIZ
-    uint32_t root_address = bpb_froot_addr(bpb);
-    uint32_t root_size = sizeof(struct fat_dir) * bpb->root_entry_count;
-
-    // LEITURA DO DIRETÓRIO RAIZ
-    struct fat_dir root[root_size];
-    if (read_bytes(fp, root_address, &root, root_size) == RB_ERROR)
-    {
-        error_at_line(EXIT_FAILURE, EIO, __FILE__, __LINE__, "erro ao ler struct fat_dir");
-    }
-
-    struct far_dir_searchres dir1 = find_in_root(root, source_rname, bpb);
+    // BUSCA DA FONTE PELO CAMINHO E VERIFICAÇÃO DO DESTINO
+    uint32_t *fat = fat_load(fp, bpb);
+    struct fat_dir source_entry, dest_entry;
+    uint64_t dest_address;
 
-    if (!dir1.found)
+    if (!fat_find(fp, bpb, fat, source, &source_entry, NULL))
         error(EXIT_FAILURE, 0, "Não foi possível encontrar o arquivo %s.", source);
 
-    if (find_in_root(root, dest_rname, bpb).found)
-        error(EXIT_FAILURE, 0, "Não permitido substituir arquivo %s via cp.", dest);
-
-    struct fat_dir new_dir = dir1.fdir;
-    memcpy(new_dir.name, dest_rname, FAT16STR_SIZE);
-    bool dentry_failure = true;
+    if (source_entry.attr & DIR_ATTR_DIRECTORY)
+        error(EXIT_FAILURE, 0, "%s é um diretório.", source);
 
-    //BUSCA DE ENTRADA LIVRE EM DIRETÓRIO RAIZ
-    for (int i = 0; i < bpb->root_entry_count; i++) if (root[i].name[0] == DIR_FREE_ENTRY || root[i].name[0] == '\0')
-    {
-        //CALCULO ENDEREÇO FINAL
-        uint32_t dest_address = sizeof (struct fat_dir) * i + root_address;
-
-        //APLICAÇÃO NEW_DIR EM DIRETÓRIO RAIZ (NOVO DIRETÓRIO)
-        (void) fseek (fp, dest_address, SEEK_SET);
-        (void) fwrite
-        (
-            &new_dir,
-            sizeof (struct fat_dir),
-            1,
-            fp
-        );
-
-        dentry_failure = false;
-
-        break;
-    }
+    if (fat_find(fp, bpb, fat, dest, &dest_entry, NULL))
+        error(EXIT_FAILURE, 0, "Não permitido substituir arquivo %s via cp.", dest);
 
-    if (dentry_failure)
+    if (!fat_root_free_entry(fp, bpb, fat, &dest_address))
         error_at_line(EXIT_FAILURE, ENOSPC, __FILE__, __LINE__, "Não foi possivel alocar uma entrada no diretório raiz.");
 
-    //ALOCAÇÃO DE CLUSTERS PARA NOVO ARQUIVO
-    // Contador de clusters
-    int count = 0;
+    //ALOCAÇÃO DE CLUSTERS PARA NOVO ARQUIVO, NA FAT EM MEMÓRIA
+    const uint32_t cluster_width = bpb->geo.cluster_width;
+    uint32_t count = (uint32_t) (((uint64_t) source_entry.file_size + cluster_width - 1) / cluster_width);
+    uint32_t *chain = malloc((count ? count : 1) * sizeof(uint32_t));
 
-    //CLUSTERS
-    {
-        /*
-         * Detalhes sobre a alocação de novos clusters:S
-         * A alocação dos clusters ocorre de trás para frente; o último é alocado primeiro,
-         * principalmente para garantir que seu valor seja FAT16_EOF_HI.
-        */
-        struct fat16_newcluster_info next_cluster, prev_cluster = { .cluster = FAT16_EOF_HI };
-        //NUMERO DE CLUSTERS QUE O ARQUIVO PRECISA 
-        uint32_t cluster_count = dir1.fdir.file_size / bpb->bytes_p_sect / bpb->sector_p_clust + 1;
-        // ALOCA-SE CLUSTERS GRAVANDO-O NA FAT
-        while (cluster_count--)
-        {
-            prev_cluster = next_cluster;
-            next_cluster = fat16_find_free_cluster(fp, bpb); /* Busca-se novo cluster */
+    if (!chain)
+        error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar a lista de clusters");
 
-            if (next_cluster.cluster == 0x0)
-                error_at_line(EXIT_FAILURE, EIO, __FILE__, __LINE__, "Disco cheio (imagem foi corrompida)");
+    for (uint32_t i = 0, cluster = 2; i < count; i++)
+    {
+        cluster = fat_find_free(fat, bpb, cluster);
 
-            (void) fseek (fp, next_cluster.address, SEEK_SET);
-            (void) fwrite(&prev_cluster.cluster, sizeof (uint16_t), 1, fp);
+        if (cluster == 0)
+            error_at_line(EXIT_FAILURE, ENOSPC, __FILE__, __LINE__, "Disco cheio");
 
-            count++;
-        }
+        // O novo cluster é o fim da cadeia até o próximo ser ligado a ele
+        fat[cluster] = (fat[cluster] & ~FAT32_CLUSTER_MASK) | FAT32_CLUSTER_MASK;
+        if (i > 0)
+            fat[chain[i - 1]] = (fat[chain[i - 1]] & ~FAT32_CLUSTER_MASK) | cluster;
 
-        //CLUSTER DE INICIO SALVO NO DIRETÓRIO
-        new_dir.starting_cluster = next_cluster.cluster;
+        chain[i] = cluster;
     }
 
-    {
-        /* MESMA LÓGICA QUE USADA NO MÉTODO cat() */
-        const uint32_t fat_address       = bpb_faddress(bpb);
-        const uint32_t data_region_start = bpb_fdata_addr(bpb);
-        const uint32_t cluster_width     = bpb->bytes_p_sect * bpb->sector_p_clust;
-
-        size_t bytes_to_copy = new_dir.file_size;
-
-        /* AMBOS OS ARQUIVOS, FONTE E DESTINO, SÃO ITERADOS SIMULTANEAMENTE*/
-        uint16_t source_cluster_number = dir1.fdir.starting_cluster;
-        uint16_t destin_cluster_number = new_dir.starting_cluster;
+    // CÓPIA DOS DADOS: UMA ESCRITA POR TRECHO DE CLUSTERS CONSECUTIVOS
+    const size_t buffer_size = MAX(CP_BUFFER, cluster_width);
+    char *filedata = malloc(buffer_size);
+    uint64_t offset = 0;
 
-        while (bytes_to_copy != 0)
-        {
-            uint32_t source_cluster_address = (source_cluster_number - 2) * cluster_width + data_region_start;
-            uint32_t destin_cluster_address = (destin_cluster_number - 2) * cluster_width + data_region_start;
+    if (!filedata)
+        error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar buffer de cópia");
 
-            size_t copied_in_this_sector = MIN(bytes_to_copy, cluster_width);
+    for (uint32_t i = 0; i < count;)
+    {
+        uint32_t j = i + 1;
+        while (j < count && chain[j] == chain[j - 1] + 1 && (uint64_t) (j - i + 1) * cluster_width <= buffer_size)
+            j++;
 
-            char filedata[cluster_width];
+        size_t want = MIN((uint64_t) (j - i) * cluster_width, source_entry.file_size - offset);
+        size_t got  = fat_read_at(fp, bpb, &source_entry, offset, filedata, want);
 
-            // LÊ DA FONTE E ESCREVE NO DESTINO
-            (void) read_bytes(fp, source_cluster_address, filedata, copied_in_this_sector);
-            (void) fseek     (fp, destin_cluster_address, SEEK_SET);
-            (void) fwrite    (filedata, sizeof (char), copied_in_this_sector, fp);
+        // Cadeia da fonte mais curta que file_size: o resto fica zerado
+        memset(filedata + got, 0, want - got);
 
-            bytes_to_copy -= copied_in_this_sector;
+        if (fseek(fp, (long) bpb_cluster_addr(bpb, chain[i]), SEEK_SET) != 0)
+            error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao posicionar o ponteiro do arquivo");
 
-            uint32_t source_next_cluster_address = fat_address + source_cluster_number * sizeof (uint16_t);
-            uint32_t destin_next_cluster_address = fat_address + destin_cluster_number * sizeof (uint16_t);
+        if (fwrite(filedata, 1, want, fp) != want)
+            error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao escrever os dados");
 
-            (void) read_bytes(fp, source_next_cluster_address, &source_cluster_number, sizeof (uint16_t));
-            (void) read_bytes(fp, destin_next_cluster_address, &destin_cluster_number, sizeof (uint16_t));
-        }
+        offset += want;
+        i = j;
     }
 
-    printf("cp %s → %s, %i clusters copiados.\n", source, dest, count);
-
-    return;
-}
-
-void cat(FILE* fp, char* filename, struct fat_bpb* bpb)
-{
-    //LEITURA/ MANIPUÇ DIRETÓRIO RAIZ  
+    // FAT (TODAS AS CÓPIAS) E SÓ ENTÃO A ENTRADA DE DIRETÓRIO
+    fat_store(fp, bpb, fat, chain, count);
+    fsinfo_update(fp, bpb, -(int64_t) count, 0);
 
-    char rname[FAT16STR_SIZE_WNULL];
+    struct fat_dir new_dir = source_entry;
+    memcpy(new_dir.name, dest_rname, FAT16STR_SIZE);
+    new_dir.starting_cluster    = count ? (uint16_t) chain[0] : 0;
+    new_dir.starting_cluster_hi = count ? (uint16_t) (chain[0] >> 16) : 0;
 
-    bool badname = cstr_to_fat16wnull(filename, rname);
+    if (fseek(fp, (long) dest_address, SEEK_SET) != 0)
+        error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao posicionar o ponteiro do arquivo");
 
-    if (badname)
-    {
-        fprintf(stderr, "Nome de arquivo inválido.\n");
-        exit(EXIT_FAILURE);
-    }
+    if (fwrite(&new_dir, sizeof(struct fat_dir), 1, fp) != 1)
+        error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao escrever a entrada do diretório");
 
-    uint32_t root_address = bpb_froot_addr(bpb);
-    uint32_t root_size    = sizeof (struct fat_dir) * bpb->root_entry_count;
+    extent_cache_invalidate(0);
 
-    struct fat_dir root[root_size];
+    printf("cp %s → %s, %u clusters copiados.\n", source, dest, count);
 
-    if (read_bytes(fp, root_address, &root, root_size) == RB_ERROR)
-        error_at_line(EXIT_FAILURE, EIO, __FILE__, __LINE__, "erro ao ler struct fat_dir");
+    free(filedata);
+    free(chain);
+    free(fat);
+}
 
-    struct far_dir_searchres dir = find_in_root(&root[0], rname, bpb);
+void cat(FILE* fp, char* filename, struct fat_bpb* bpb, uint64_t offset, uint64_t length)
+{
+    // BUSCA DO ARQUIVO PELO CAMINHO (RAIZ OU SUBDIRETÓRIOS)
+    struct fat_dir entry;
 
-    if (dir.found == false)
+    if (!fat_find(fp, bpb, extent_cache_fat(fp, bpb), filename, &entry, NULL))
         error(EXIT_FAILURE, 0, "Não foi possivel encontrar o %s.", filename);
 
-    // DETERMINAÇÃO TAMANHO DO ARQUIVO
-    size_t   bytes_to_read     = dir.fdir.file_size;
-
-    // ENDEREÇO REGIÃO DE DADOS // INICIO REGIÃO DE DADOS 
-    uint32_t data_region_start = bpb_fdata_addr(bpb);
-    uint32_t fat_address       = bpb_faddress(bpb);
-
-    // LEITURA DE CLUSTERS // PRIMEIRO CLUSTER ESTÁ 
-    uint16_t cluster_number    = dir.fdir.starting_cluster;
+    if (offset > entry.file_size)
+        error(EXIT_FAILURE, 0, "Offset %llu além do fim de %s (%u bytes).", (unsigned long long) offset, filename, entry.file_size);
 
-    const uint32_t cluster_width = bpb->bytes_p_sect * bpb->sector_p_clust;
+    // LEITURA EM BLOCOS; O MAPA DE EXTENTS LEVA DIRETO AO CLUSTER DO OFFSET
+    char filedata[64 * 1024];
 
-    while (bytes_to_read != 0)
+    while (length != 0)
     {
-        /* LEITURA */
-        {
-            // PROCURA ONDE ESTÁ CLUSTAR ATUAL EM DISCO
-            uint32_t cluster_address     = (cluster_number - 2) * cluster_width + data_region_start;
-
-            // QUANTOS BYTES LER NESSE CLUSTER
-            size_t read_in_this_sector = MIN(bytes_to_read, cluster_width);
+        size_t read_now = fat_read_at(fp, bpb, &entry, offset, filedata, MIN(length, sizeof (filedata)));
 
-            char filedata[cluster_width];
-
-            // LEITURA CLUSTER ATUAL
-            read_bytes(fp, cluster_address, filedata, read_in_this_sector);
-            printf("%.*s", (signed) read_in_this_sector, filedata);
-
-            bytes_to_read -= read_in_this_sector;
-        }
+        if (read_now == 0)
+            break;
 
-        // CALCULO DE ENDEREÇO TABELA DE ALOCAÇÃO / LOCALIZAÇÃO DO PRÓXIMO CLUSTER
-        uint32_t next_cluster_address = fat_address + cluster_number * sizeof (uint16_t);
+        fwrite(filedata, 1, read_now, stdout);
 
-        //LER ENTRADA/ DESCOBRIR QUAL É O PRÓXIMO CLUSTER
-        read_bytes(fp, next_cluster_address, &cluster_number, sizeof (uint16_t));
+        offset += read_now;
+        length -= read_now;
     }
 
-    return;
-}
\ No newline at end of file
+    // A IMAGEM É FECHADA EM SEGUIDA; O CACHE NÃO PODE SOBREVIVER A ELA
+    extent_cache_invalidate(0);
+}
@@ -0,0 +1,542 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include <errno.h>
+#include <error.h>
+
+#include "container.h"
+#include "commands.h"
+#include "support.h"
+
+#define CONTAINER_MAGIC "OB32Z001"
+#define CONTAINER_MAX_THREADS 8
+
+struct container_header
+{
+	char     magic[8];
+	uint32_t chunk_size;
+	uint32_t reserved;
+	uint64_t image_size;   // tamanho da imagem descomprimida
+	uint64_t chunk_count;
+	uint64_t index_offset; // onde está o índice em vigor
+};
+
+struct container_entry
+{
+	uint64_t offset; // posição do chunk comprimido no arquivo
+	uint32_t length; // tamanho comprimido
+	uint32_t reserved;
+};
+
+struct chunk_slot
+{
+	int64_t  chunk;    // -1 = vazio
+	uint64_t last_use;
+	bool     dirty;
+	uint8_t *data;
+};
+
+struct container
+{
+	int      fd;
+	bool     writable;
+	struct container_header hdr;
+	struct container_entry *index;
+	bool     index_dirty;
+	uint64_t end;      // fim do arquivo: onde chunks novos são acrescentados
+	uint64_t tick;
+	struct chunk_slot slots[CONTAINER_CACHE];
+	off64_t  pos;
+};
+
+///
+/// PARALELISMO
+
+/*
+ * Roda job(arg, i) para i em [0, count) em até CONTAINER_MAX_THREADS threads.
+ * Cada thread pega os índices i, i + n, i + 2n... sem coordenação.
+ */
+struct parallel_task
+{
+	void   (*job)(void *, size_t);
+	void    *arg;
+	size_t   count;
+	size_t   first;
+	size_t   step;
+};
+
+static void *parallel_worker(void *p)
+{
+	struct parallel_task *task = p;
+	for (size_t i = task->first; i < task->count; i += task->step)
+		task->job(task->arg, i);
+	return NULL;
+}
+
+static void parallel_for(size_t count, void (*job)(void *, size_t), void *arg)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t n = MIN(count, (size_t) MIN(cpus > 0 ? cpus : 1, CONTAINER_MAX_THREADS));
+
+	if (n <= 1)
+	{
+		for (size_t i = 0; i < count; i++)
+			job(arg, i);
+		return;
+	}
+
+	pthread_t threads[CONTAINER_MAX_THREADS];
+	bool started[CONTAINER_MAX_THREADS];
+	struct parallel_task tasks[CONTAINER_MAX_THREADS];
+	for (size_t t = 0; t < n; t++)
+	{
+		tasks[t] = (struct parallel_task) { .job = job, .arg = arg, .count = count, .first = t, .step = n };
+		started[t] = pthread_create(&threads[t], NULL, parallel_worker, &tasks[t]) == 0;
+		if (!started[t])
+			parallel_worker(&tasks[t]); // sem thread: faz a parte dela aqui mesmo
+	}
+	for (size_t t = 0; t < n; t++)
+		if (started[t])
+			pthread_join(threads[t], NULL);
+}
+
+///
+/// CHUNKS
+
+/* Tamanho descomprimido do chunk; o último pode ser menor */
+static size_t chunk_length(struct container *c, uint64_t chunk)
+{
+	return MIN(c->hdr.chunk_size, c->hdr.image_size - chunk * c->hdr.chunk_size);
+}
+
+static void chunk_decompress(struct container *c, uint64_t chunk, uint8_t *out)
+{
+	struct container_entry *e = &c->index[chunk];
+	uint8_t *packed = malloc(e->length);
+	if (!packed)
+		error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar buffer de chunk");
+
+	full_pread(c->fd, packed, e->length, e->offset);
+
+	uLongf len = chunk_length(c, chunk);
+	if (uncompress(out, &len, packed, e->length) != Z_OK || len != chunk_length(c, chunk))
+		error(EXIT_FAILURE, 0, "Chunk %llu do contêiner está corrompido.", (unsigned long long) chunk);
+
+	free(packed);
+}
+
+/* Recomprime um chunk alterado e o acrescenta no fim do arquivo */
+static void chunk_store(struct container *c, struct chunk_slot *slot)
+{
+	size_t len = chunk_length(c, slot->chunk);
+	uLongf packed_len = compressBound(len);
+	uint8_t *packed = malloc(packed_len);
+	if (!packed)
+		error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar buffer de chunk");
+
+	if (compress2(packed, &packed_len, slot->data, len, Z_DEFAULT_COMPRESSION) != Z_OK)
+		error_at_line(EXIT_FAILURE, 0, __FILE__, __LINE__, "erro ao comprimir o chunk %lld", (long long) slot->chunk);
+
+	full_pwrite(c->fd, packed, packed_len, c->end);
+	c->index[slot->chunk] = (struct container_entry) { .offset = c->end, .length = (uint32_t) packed_len };
+	c->end += packed_len;
+	c->index_dirty = true;
+	slot->dirty = false;
+
+	free(packed);
+}
+
+/* Libera o slot menos usado recentemente (gravando-o se estiver sujo) */
+static struct chunk_slot *slot_evict(struct container *c)
+{
+	struct chunk_slot *victim = &c->slots[0];
+	for (int i = 0; i < CONTAINER_CACHE; i++)
+	{
+		if (c->slots[i].chunk < 0)
+			return &c->slots[i];
+		if (c->slots[i].last_use < victim->last_use)
+			victim = &c->slots[i];
+	}
+
+	if (victim->dirty)
+		chunk_store(c, victim);
+	victim->chunk = -1;
+	return victim;
+}
+
+static struct chunk_slot *slot_find(struct container *c, uint64_t chunk)
+{
+	for (int i = 0; i < CONTAINER_CACHE; i++)
+		if (c->slots[i].chunk == (int64_t) chunk)
+			return &c->slots[i];
+	return NULL;
+}
+
+/* Slot com o chunk carregado, descomprimindo se não estiver no cache */
+static struct chunk_slot *slot_get(struct container *c, uint64_t chunk)
+{
+	struct chunk_slot *slot = slot_find(c, chunk);
+	if (!slot)
+	{
+		slot = slot_evict(c);
+		chunk_decompress(c, chunk, slot->data);
+		slot->chunk = (int64_t) chunk;
+	}
+	slot->last_use = ++c->tick;
+	return slot;
+}
+
+struct prefetch_job
+{
+	struct container   *c;
+	struct chunk_slot **slots;
+};
+
+static void prefetch_one(void *arg, size_t i)
+{
+	struct prefetch_job *job = arg;
+	chunk_decompress(job->c, (uint64_t) job->slots[i]->chunk, job->slots[i]->data);
+}
+
+/*
+ * Carrega de uma vez os chunks de [first, last] que não estão no cache,
+ * descomprimindo em paralelo. Limita-se a metade do cache para não expulsar
+ * o que acabou de carregar.
+ */
+static void container_prefetch(struct container *c, uint64_t first, uint64_t last)
+{
+	struct chunk_slot *slots[CONTAINER_CACHE / 2];
+	size_t count = 0;
+
+	for (uint64_t chunk = first; chunk <= last && count < CONTAINER_CACHE / 2; chunk++)
+	{
+		if (slot_find(c, chunk))
+			continue;
+		struct chunk_slot *slot = slot_evict(c);
+		slot->chunk    = (int64_t) chunk;
+		slot->last_use = ++c->tick;
+		slots[count++] = slot;
+	}
+
+	struct prefetch_job job = { .c = c, .slots = slots };
+	parallel_for(count, prefetch_one, &job);
+}
+
+///
+/// FUNÇÕES DO COOKIE (fopencookie)
+
+static ssize_t container_read(void *cookie, char *buf, size_t size)
+{
+	struct container *c = cookie;
+	uint64_t pos = (uint64_t) c->pos;
+
+	if (pos >= c->hdr.image_size)
+		return 0;
+	size = MIN(size, c->hdr.image_size - pos);
+
+	uint64_t end = pos + size;
+	if ((end - 1) / c->hdr.chunk_size > pos / c->hdr.chunk_size)
+		container_prefetch(c, pos / c->hdr.chunk_size, (end - 1) / c->hdr.chunk_size);
+
+	while (pos < end)
+	{
+		uint64_t chunk  = pos / c->hdr.chunk_size;
+		size_t   within = pos % c->hdr.chunk_size;
+		size_t   len    = MIN(c->hdr.chunk_size - within, end - pos);
+
+		memcpy(buf, slot_get(c, chunk)->data + within, len);
+		buf += len;
+		pos += len;
+	}
+
+	c->pos += size;
+	return size;
+}
+
+static ssize_t container_write(void *cookie, const char *buf, size_t size)
+{
+	struct container *c = cookie;
+	uint64_t pos = (uint64_t) c->pos;
+
+	if (!c->writable)
+	{
+		errno = EROFS;
+		return 0;
+	}
+	if (pos >= c->hdr.image_size)
+	{
+		errno = ENOSPC;
+		return 0;
+	}
+	size = MIN(size, c->hdr.image_size - pos);
+
+	uint64_t end = pos + size;
+	while (pos < end)
+	{
+		uint64_t chunk  = pos / c->hdr.chunk_size;
+		size_t   within = pos % c->hdr.chunk_size;
+		size_t   len    = MIN(c->hdr.chunk_size - within, end - pos);
+
+		struct chunk_slot *slot = slot_get(c, chunk);
+		memcpy(slot->data + within, buf, len);
+		slot->dirty = true;
+		buf += len;
+		pos += len;
+	}
+
+	c->pos += size;
+	return size;
+}
+
+static int container_seek(void *cookie, off64_t *offset, int whence)
+{
+	struct container *c = cookie;
+	off64_t base;
+
+	switch (whence)
+	{
+		case SEEK_SET: base = 0; break;
+		case SEEK_CUR: base = c->pos; break;
+		case SEEK_END: base = (off64_t) c->hdr.image_size; break;
+		default: errno = EINVAL; return -1;
+	}
+
+	if (base + *offset < 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	c->pos = *offset = base + *offset;
+	return 0;
+}
+
+/*
+ * Grava os chunks sujos e, se algum mudou, um índice novo no fim do arquivo.
+ * O cabeçalho é reescrito por último: até lá o índice antigo continua valendo.
+ */
+static int container_close(void *cookie)
+{
+	struct container *c = cookie;
+
+	for (int i = 0; i < CONTAINER_CACHE; i++)
+		if (c->slots[i].chunk >= 0 && c->slots[i].dirty)
+			chunk_store(c, &c->slots[i]);
+
+	if (c->index_dirty)
+	{
+		size_t index_size = c->hdr.chunk_count * sizeof(struct container_entry);
+		full_pwrite(c->fd, c->index, index_size, c->end);
+		if (fsync(c->fd) != 0)
+			error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao sincronizar o contêiner");
+
+		c->hdr.index_offset = c->end;
+		full_pwrite(c->fd, &c->hdr, sizeof(struct container_header), 0);
+		fsync(c->fd);
+	}
+
+	for (int i = 0; i < CONTAINER_CACHE; i++)
+		free(c->slots[i].data);
+	free(c->index);
+	close(c->fd);
+	free(c);
+	return 0;
+}
+
+///
+
+bool container_detect(const char *path)
+{
+	char magic[8];
+	FILE *fp = fopen(path, "rb");
+	if (!fp)
+		return false;
+
+	bool found = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) && memcmp(magic, CONTAINER_MAGIC, 8) == 0;
+	fclose(fp);
+	return found;
+}
+
+FILE *container_open(const char *path)
+{
+	struct container *c = calloc(1, sizeof(struct container));
+	if (!c)
+		error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar o contêiner");
+
+	// Sem permissão de escrita o contêiner ainda pode ser lido
+	c->writable = true;
+	c->fd = open(path, O_RDWR | O_CLOEXEC);
+	if (c->fd < 0)
+	{
+		c->writable = false;
+		c->fd = open(path, O_RDONLY | O_CLOEXEC);
+	}
+	if (c->fd < 0)
+	{
+		free(c);
+		return NULL;
+	}
+
+	full_pread(c->fd, &c->hdr, sizeof(struct container_header), 0);
+	if (memcmp(c->hdr.magic, CONTAINER_MAGIC, 8) != 0 || c->hdr.chunk_size == 0
+	    || c->hdr.chunk_count != (c->hdr.image_size + c->hdr.chunk_size - 1) / c->hdr.chunk_size)
+		error(EXIT_FAILURE, 0, "%s não é um contêiner válido.", path);
+
+	size_t index_size = c->hdr.chunk_count * sizeof(struct container_entry);
+	c->index = malloc(index_size + 1);
+	if (!c->index)
+		error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar o índice do contêiner");
+	full_pread(c->fd, c->index, index_size, c->hdr.index_offset);
+
+	struct stat st;
+	fstat(c->fd, &st);
+	c->end = (uint64_t) st.st_size;
+
+	for (int i = 0; i < CONTAINER_CACHE; i++)
+	{
+		c->slots[i].chunk = -1;
+		c->slots[i].data  = malloc(c->hdr.chunk_size);
+		if (!c->slots[i].data)
+			error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar o cache do contêiner");
+	}
+
+	cookie_io_functions_t io =
+	{
+		.read  = container_read,
+		.write = container_write,
+		.seek  = container_seek,
+		.close = container_close,
+	};
+
+	FILE *fp = fopencookie(c, c->writable ? "r+" : "r", io);
+	if (!fp)
+		container_close(c);
+
+	return fp;
+}
+
+///
+/// PACK / UNPACK
+
+struct pack_job
+{
+	const uint8_t *raw;      // lote de chunks crus, em sequência
+	size_t         raw_len;
+	uint8_t      **packed;
+	uLongf        *packed_len;
+};
+
+static void pack_one(void *arg, size_t i)
+{
+	struct pack_job *job = arg;
+	size_t offset = i * CONTAINER_CHUNK;
+	size_t len    = MIN(CONTAINER_CHUNK, job->raw_len - offset);
+
+	job->packed_len[i] = compressBound(len);
+	job->packed[i]     = malloc(job->packed_len[i]);
+	if (!job->packed[i] || compress2(job->packed[i], &job->packed_len[i], job->raw + offset, len, Z_DEFAULT_COMPRESSION) != Z_OK)
+		error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "erro ao comprimir o chunk");
+}
+
+/*
+ * A entrada pode ser uma imagem crua ou outro contêiner: empacotar um
+ * contêiner de novo descarta os chunks antigos deixados pelas escritas.
+ */
+void container_pack(const char *image_path, const char *container_path)
+{
+	if (strcmp(image_path, container_path) == 0)
+		error(EXIT_FAILURE, 0, "A entrada e a saída do pack precisam ser arquivos diferentes.");
+
+	FILE *in = container_detect(image_path) ? container_open(image_path) : fopen(image_path, "rb");
+	if (!in || fseek(in, 0, SEEK_END) != 0)
+		error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao abrir %s", image_path);
+
+	struct container_header hdr = { .chunk_size = CONTAINER_CHUNK, .image_size = (uint64_t) ftell(in) };
+	memcpy(hdr.magic, CONTAINER_MAGIC, 8);
+	hdr.chunk_count = (hdr.image_size + CONTAINER_CHUNK - 1) / CONTAINER_CHUNK;
+	rewind(in);
+
+	int out = open(container_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (out < 0)
+		error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao criar %s", container_path);
+
+	struct container_entry *index = calloc(hdr.chunk_count + 1, sizeof(struct container_entry));
+
+	// COMPRIME EM LOTES, EM PARALELO, E GRAVA NA ORDEM
+	const size_t batch = CONTAINER_CACHE / 2;
+	uint8_t *raw          = malloc(batch * CONTAINER_CHUNK);
+	uint8_t **packed      = calloc(batch, sizeof(uint8_t *));
+	uLongf  *packed_len   = calloc(batch, sizeof(uLongf));
+	if (!index || !raw || !packed || !packed_len)
+		error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar buffers do pack");
+
+	uint64_t end = sizeof(struct container_header);
+	for (uint64_t first = 0; first < hdr.chunk_count; first += batch)
+	{
+		size_t count   = MIN(batch, hdr.chunk_count - first);
+		size_t raw_len = MIN(count * CONTAINER_CHUNK, hdr.image_size - first * CONTAINER_CHUNK);
+		if (fread(raw, 1, raw_len, in) != raw_len)
+			error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao ler %s", image_path);
+
+		struct pack_job job = { .raw = raw, .raw_len = raw_len, .packed = packed, .packed_len = packed_len };
+		parallel_for(count, pack_one, &job);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			full_pwrite(out, packed[i], packed_len[i], end);
+			index[first + i] = (struct container_entry) { .offset = end, .length = (uint32_t) packed_len[i] };
+			end += packed_len[i];
+			free(packed[i]);
+		}
+	}
+
+	hdr.index_offset = end;
+	full_pwrite(out, index, hdr.chunk_count * sizeof(struct container_entry), end);
+	full_pwrite(out, &hdr, sizeof(hdr), 0);
+
+	if (close(out) != 0)
+		error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao gravar %s", container_path);
+	fclose(in);
+	free(raw), free(packed), free(packed_len), free(index);
+
+	uint64_t total = end + hdr.chunk_count * sizeof(struct container_entry);
+	printf("%s → %s, %llu chunks, %llu → %llu bytes.\n", image_path, container_path,
+	       (unsigned long long) hdr.chunk_count, (unsigned long long) hdr.image_size, (unsigned long long) total);
+}
+
+void container_unpack(const char *container_path, const char *image_path)
+{
+	FILE *in = container_open(container_path);
+	if (!in)
+		error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao abrir %s", container_path);
+
+	FILE *out = fopen(image_path, "wb");
+	if (!out)
+		error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao criar %s", image_path);
+
+	// Leituras de vários chunks por vez aproveitam a descompressão paralela
+	size_t len = (CONTAINER_CACHE / 2) * CONTAINER_CHUNK, n;
+	char *buffer = malloc(len);
+	if (!buffer)
+		error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar buffer do unpack");
+
+	while ((n = fread(buffer, 1, len, in)) > 0)
+		if (fwrite(buffer, 1, n, out) != n)
+			error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao escrever %s", image_path);
+
+	free(buffer);
+	fclose(in);
+	if (fclose(out) != 0)
+		error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao gravar %s", image_path);
+
+	printf("%s → %s.\n", container_path, image_path);
+}
@@ -0,0 +1,467 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <errno.h>
+#include <error.h>
+
+#include "delta.h"
+#include "commands.h"
+#include "container.h"
+#include "extent.h"
+#include "hash.h"
+
+#define DELTA_MAGIC "OB32DLT1"
+
+struct delta_header
+{
+	char     magic[8];
+	uint64_t image_size;    // até o fim do último cluster
+	uint32_t data_addr;     // geometria da imagem; a do destino tem que bater
+	uint32_t cluster_width;
+	uint64_t records;
+	uint64_t bytes;         // soma dos trechos
+};
+
+struct delta_record
+{
+	uint64_t offset;
+	uint32_t length;
+	uint32_t base_crc; // CRC32C do trecho na imagem de destino, antes
+	uint32_t new_crc;  // CRC32C dos dados que seguem o registro
+	uint32_t reserved;
+};
+
+struct delta_scan
+{
+	FILE           *src, *dst;   // imagem nova e a que será atualizada
+	struct fat_bpb *src_bpb, *dst_bpb;
+	uint8_t        *a, *b;       // DELTA_CHUNK bytes de cada uma
+	FILE           *out;         // delta sendo gravado (NULL: só marca os clusters)
+	uint8_t        *changed;     // bitmap dos clusters alterados
+	uint64_t        records, bytes, meta_bytes;
+};
+
+static uint64_t delta_image_size(struct fat_bpb *bpb)
+{
+	return bpb->geo.data_addr + (uint64_t) bpb->geo.cluster_count * bpb->geo.cluster_width;
+}
+
+static FILE *delta_open_image(const char *path)
+{
+	FILE *fp = container_detect(path) ? container_open(path) : fopen(path, "rb");
+
+	if (!fp)
+		error(EXIT_FAILURE, errno, "%s", path);
+
+	return fp;
+}
+
+static void delta_check_geometry(struct fat_bpb *a, struct fat_bpb *b)
+{
+	if (a->bytes_p_sect != b->bytes_p_sect || a->geo.engine != b->geo.engine
+	    || a->geo.cluster_width != b->geo.cluster_width || a->geo.data_addr != b->geo.data_addr
+	    || a->geo.cluster_count != b->geo.cluster_count)
+		error(EXIT_FAILURE, 0, "As imagens têm geometrias diferentes; copie a imagem inteira.");
+}
+
+static void delta_read(FILE *fp, uint64_t offset, void *buf, uint32_t len)
+{
+	if (read_bytes(fp, offset, buf, len) == RB_ERROR)
+		error_at_line(EXIT_FAILURE, EIO, __FILE__, __LINE__, "erro ao ler a imagem em 0x%llx", (unsigned long long) offset);
+}
+
+///
+/// COMPARAÇÃO
+
+/* Um trecho alterado: conta, marca os clusters e grava no delta */
+static void delta_emit(struct delta_scan *scan, uint64_t offset, uint32_t length, const uint8_t *base, const uint8_t *data)
+{
+	struct fat_bpb *bpb = scan->src_bpb;
+
+	scan->records++;
+	scan->bytes += length;
+
+	if (offset < bpb->geo.data_addr)
+		scan->meta_bytes += length;
+	else if (scan->changed)
+		for (uint64_t c = (offset - bpb->geo.data_addr) / bpb->geo.cluster_width + 2,
+		              end = c + length / bpb->geo.cluster_width; c < end; c++)
+			scan->changed[c / 8] |= (uint8_t) (1 << (c % 8));
+
+	if (!scan->out)
+		return;
+
+	struct delta_record record =
+	{
+		.offset   = offset,
+		.length   = length,
+		.base_crc = crc32c(0, base, length),
+		.new_crc  = crc32c(0, data, length),
+	};
+
+	if (fwrite(&record, sizeof(record), 1, scan->out) != 1 || fwrite(data, 1, length, scan->out) != length)
+		error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao gravar o delta");
+}
+
+/*
+ * Lê o mesmo trecho das duas imagens e emite as sequências de unidades
+ * (setores ou clusters) diferentes, cada uma como um registro.
+ */
+static void delta_compare(struct delta_scan *scan, uint64_t offset, uint32_t length, uint32_t unit)
+{
+	delta_read(scan->src, offset, scan->a, length);
+	delta_read(scan->dst, offset, scan->b, length);
+
+	// CAMINHO RÁPIDO: TRECHO INTEIRO IGUAL
+	if (memcmp(scan->a, scan->b, length) == 0)
+		return;
+
+	for (uint32_t pos = 0; pos < length;)
+	{
+		if (memcmp(scan->a + pos, scan->b + pos, unit) == 0)
+		{
+			pos += unit;
+			continue;
+		}
+
+		uint32_t end = pos + unit;
+		while (end < length && memcmp(scan->a + end, scan->b + end, unit) != 0)
+			end += unit;
+
+		delta_emit(scan, offset + pos, end - pos, scan->b + pos, scan->a + pos);
+		pos = end;
+	}
+}
+
+static void delta_scan_images(struct delta_scan *scan)
+{
+	struct fat_bpb *bpb = scan->src_bpb;
+	const uint32_t cluster_width = bpb->geo.cluster_width;
+	const uint32_t chunk = MAX(DELTA_CHUNK, cluster_width);
+
+	scan->a = malloc(chunk);
+	scan->b = malloc(chunk);
+	if (!scan->a || !scan->b)
+		error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar buffers de comparação");
+
+	// METADADOS (BOOT, FSINFO, FATS, RAIZ FIXO): SETOR A SETOR
+	for (uint64_t offset = 0; offset < bpb->geo.data_addr; offset += chunk)
+		delta_compare(scan, offset, (uint32_t) MIN(chunk, bpb->geo.data_addr - offset), bpb->bytes_p_sect);
+
+	// DADOS: SÓ CLUSTERS OCUPADOS NA ORIGEM, EM SEQUÊNCIAS DE CLUSTERS VIZINHOS
+	uint32_t *fat = fat_load(scan->src, bpb);
+	const uint32_t count = fat_entry_count(bpb);
+
+	for (uint32_t cluster = 2; cluster < count;)
+	{
+		if ((fat[cluster] & FAT32_CLUSTER_MASK) == 0)
+		{
+			cluster++;
+			continue;
+		}
+
+		uint32_t run = 1;
+		while (cluster + run < count && (fat[cluster + run] & FAT32_CLUSTER_MASK) != 0
+		       && (uint64_t) (run + 1) * cluster_width <= chunk)
+			run++;
+
+		delta_compare(scan, bpb_cluster_addr(bpb, cluster), run * cluster_width, cluster_width);
+		cluster += run;
+	}
+
+	free(fat);
+	free(scan->a);
+	free(scan->b);
+}
+
+/* Grava em `out` o delta que transforma `dst` em `src` */
+static void delta_write(struct delta_scan *scan, FILE *out)
+{
+	struct delta_header header = { .magic = DELTA_MAGIC };
+
+	header.image_size    = delta_image_size(scan->src_bpb);
+	header.data_addr     = scan->src_bpb->geo.data_addr;
+	header.cluster_width = scan->src_bpb->geo.cluster_width;
+
+	// O CABEÇALHO É REESCRITO NO FIM, COM AS CONTAGENS
+	scan->out = out;
+	if (fwrite(&header, sizeof(header), 1, out) != 1)
+		error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao gravar o delta");
+
+	delta_scan_images(scan);
+
+	header.records = scan->records;
+	header.bytes   = scan->bytes;
+
+	if (fseek(out, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, out) != 1 || fflush(out) != 0)
+		error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao gravar o delta");
+}
+
+///
+/// LISTA DE ARQUIVOS
+
+struct delta_file
+{
+	char           path[FAT_PATH_MAX];
+	struct fat_dir entry;
+};
+
+struct delta_list
+{
+	struct delta_file *files;
+	size_t count, capacity;
+};
+
+static void delta_collect(const char *path, const struct fat_dir *entry, uint64_t address, void *arg)
+{
+	struct delta_list *list = arg;
+	(void) address;
+
+	if (list->count == list->capacity)
+	{
+		list->capacity = list->capacity ? list->capacity * 2 : 64;
+		list->files = realloc(list->files, list->capacity * sizeof(struct delta_file));
+		if (!list->files)
+			error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar a lista de arquivos");
+	}
+
+	struct delta_file *f = &list->files[list->count++];
+	snprintf(f->path, sizeof(f->path), "%s", path);
+	f->entry = *entry;
+}
+
+static int delta_by_path(const void *a, const void *b)
+{
+	return strcmp(((const struct delta_file *) a)->path, ((const struct delta_file *) b)->path);
+}
+
+static void delta_list_load(FILE *fp, struct fat_bpb *bpb, struct delta_list *list)
+{
+	uint32_t *fat = fat_load(fp, bpb);
+	fat_walk(fp, bpb, fat, delta_collect, list);
+	qsort(list->files, list->count, sizeof(struct delta_file), delta_by_path);
+	free(fat);
+}
+
+/* Algum cluster da cadeia do arquivo (na origem) mudou? */
+static bool delta_chain_changed(const uint32_t *fat, struct fat_bpb *bpb, const struct fat_dir *entry, const uint8_t *changed)
+{
+	uint32_t cluster = fat_dir_cluster(entry);
+
+	for (uint32_t steps = 0; cluster >= 2 && cluster < FAT32_EOC && steps < fat_entry_count(bpb); steps++)
+	{
+		if (changed[cluster / 8] & (1 << (cluster % 8)))
+			return true;
+		cluster = fat_next_cluster(fat, bpb, cluster);
+	}
+
+	return false;
+}
+
+/* A: só na origem; D: só no destino; M: entrada ou algum cluster diferente */
+static void delta_print_files(struct delta_scan *scan)
+{
+	struct delta_list src = { 0 }, dst = { 0 };
+	delta_list_load(scan->src, scan->src_bpb, &src);
+	delta_list_load(scan->dst, scan->dst_bpb, &dst);
+
+	uint32_t *fat = fat_load(scan->src, scan->src_bpb);
+	size_t i = 0, j = 0;
+
+	while (i < src.count || j < dst.count)
+	{
+		int order = i == src.count ? 1 : j == dst.count ? -1 : strcmp(src.files[i].path, dst.files[j].path);
+
+		if (order < 0)
+			printf("A\t%s\n", src.files[i++].path);
+		else if (order > 0)
+			printf("D\t%s\n", dst.files[j++].path);
+		else
+		{
+			struct delta_file *f = &src.files[i++], *old = &dst.files[j++];
+			if (memcmp(&f->entry, &old->entry, sizeof(struct fat_dir)) != 0
+			    || delta_chain_changed(fat, scan->src_bpb, &f->entry, scan->changed))
+				printf("M\t%s\n", f->path);
+		}
+	}
+
+	free(fat);
+	free(src.files);
+	free(dst.files);
+}
+
+///
+/// APLICAÇÃO
+
+/*
+ * Primeiro confere tudo (delta íntegro, destino é a base ou já tem o trecho
+ * novo), depois grava a área de dados e por último os metadados. Trechos que
+ * a conferência achou já no estado novo (apply repetido) não são regravados.
+ */
+static void delta_apply_stream(FILE *fp, struct fat_bpb *bpb, FILE *in, const char *name)
+{
+	struct delta_header header;
+
+	if (fseek(in, 0, SEEK_SET) != 0 || fread(&header, sizeof(header), 1, in) != 1
+	    || memcmp(header.magic, DELTA_MAGIC, sizeof(header.magic)) != 0)
+		error(EXIT_FAILURE, 0, "%s não é um delta.", name);
+
+	if (header.image_size != delta_image_size(bpb) || header.data_addr != bpb->geo.data_addr
+	    || header.cluster_width != bpb->geo.cluster_width)
+		error(EXIT_FAILURE, 0, "O delta %s é de uma imagem com outra geometria.", name);
+
+	// CADA REGISTRO OCUPA AO MENOS O CABEÇALHO DELE: O TOTAL TEM QUE CABER NO ARQUIVO
+	if (fseek(in, 0, SEEK_END) != 0)
+		error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao ler o delta");
+	long size = ftell(in);
+	if (size < (long) sizeof(header) || header.records > ((uint64_t) size - sizeof(header)) / sizeof(struct delta_record))
+		error(EXIT_FAILURE, 0, "O delta %s está corrompido.", name);
+
+	uint8_t *data = malloc(MAX(DELTA_CHUNK, bpb->geo.cluster_width));
+	uint8_t *base = malloc(MAX(DELTA_CHUNK, bpb->geo.cluster_width));
+	uint8_t *applied = calloc(header.records / 8 + 1, 1); // trechos que já estão no estado novo
+	uint64_t pending = 0, pending_bytes = 0;
+
+	if (!data || !base || !applied)
+		error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar buffers do delta");
+
+	// 0: CONFERÊNCIA; 1: ÁREA DE DADOS; 2: METADADOS
+	for (int pass = 0; pass < 3; pass++)
+	{
+		if (fseek(in, sizeof(header), SEEK_SET) != 0)
+			error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao ler o delta");
+
+		for (uint64_t r = 0; r < header.records; r++)
+		{
+			struct delta_record record;
+
+			if (fread(&record, sizeof(record), 1, in) != 1
+			    || record.length > MAX(DELTA_CHUNK, bpb->geo.cluster_width)
+			    || record.length > header.image_size || record.offset > header.image_size - record.length)
+				error(EXIT_FAILURE, 0, "O delta %s está corrompido.", name);
+
+			bool metadata = record.offset < header.data_addr;
+			bool done = (applied[r / 8] >> (r % 8)) & 1;
+			if ((pass == 1 && (metadata || done)) || (pass == 2 && (!metadata || done)))
+			{
+				if (fseek(in, record.length, SEEK_CUR) != 0)
+					error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao ler o delta");
+				continue;
+			}
+
+			if (fread(data, 1, record.length, in) != record.length)
+				error(EXIT_FAILURE, 0, "O delta %s está corrompido.", name);
+
+			if (pass == 0)
+			{
+				if (crc32c(0, data, record.length) != record.new_crc)
+					error(EXIT_FAILURE, 0, "O delta %s está corrompido.", name);
+
+				// Um trecho que já está como o novo (apply repetido) não conta
+				delta_read(fp, record.offset, base, record.length);
+				uint32_t crc = crc32c(0, base, record.length);
+
+				if (crc != record.base_crc && crc != record.new_crc)
+					error(EXIT_FAILURE, 0, "A imagem não é a base do delta %s (trecho em 0x%llx).",
+					      name, (unsigned long long) record.offset);
+				if (crc == record.new_crc)
+					applied[r / 8] |= (uint8_t) (1u << (r % 8));
+				else
+				{
+					pending++;
+					pending_bytes += record.length;
+				}
+				continue;
+			}
+
+			if (fseek(fp, (long) record.offset, SEEK_SET) != 0 || fwrite(data, 1, record.length, fp) != record.length)
+				error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao escrever a imagem");
+		}
+
+		if (pass == 1 && fflush(fp) != 0)
+			error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao escrever a imagem");
+	}
+
+	extent_cache_invalidate(0);
+	printf("%llu de %llu trechos aplicados, %llu bytes.\n", (unsigned long long) pending,
+	       (unsigned long long) header.records, (unsigned long long) pending_bytes);
+
+	free(applied);
+	free(base);
+	free(data);
+}
+
+///
+/// COMANDOS
+
+void image_diff(FILE *fp, struct fat_bpb *bpb, const char *other_path, const char *delta_path)
+{
+	FILE *other = delta_open_image(other_path);
+	struct fat_bpb other_bpb;
+
+	rfat(other, &other_bpb);
+	delta_check_geometry(&other_bpb, bpb);
+
+	struct delta_scan scan = { .src = other, .src_bpb = &other_bpb, .dst = fp, .dst_bpb = bpb };
+
+	if (delta_path)
+	{
+		FILE *out = fopen(delta_path, "wb");
+		if (!out)
+			error(EXIT_FAILURE, errno, "%s", delta_path);
+
+		delta_write(&scan, out);
+		fclose(out);
+
+		printf("%s: %llu trechos, %llu bytes (%llu de metadados).\n", delta_path, (unsigned long long) scan.records,
+		       (unsigned long long) scan.bytes, (unsigned long long) scan.meta_bytes);
+	}
+	else
+	{
+		scan.changed = calloc(fat_entry_count(&other_bpb) / 8 + 1, 1);
+		if (!scan.changed)
+			error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar o mapa de clusters");
+
+		delta_scan_images(&scan);
+		delta_print_files(&scan);
+		free(scan.changed);
+	}
+
+	fclose(other);
+}
+
+void image_apply(FILE *fp, struct fat_bpb *bpb, const char *delta_path)
+{
+	FILE *in = fopen(delta_path, "rb");
+
+	if (!in)
+		error(EXIT_FAILURE, errno, "%s", delta_path);
+
+	delta_apply_stream(fp, bpb, in, delta_path);
+	fclose(in);
+}
+
+void image_sync(FILE *fp, struct fat_bpb *bpb, const char *source_path)
+{
+	FILE *source = delta_open_image(source_path);
+	struct fat_bpb source_bpb;
+
+	rfat(source, &source_bpb);
+	delta_check_geometry(&source_bpb, bpb);
+
+	// O DELTA TEMPORÁRIO TEM O TAMANHO DA MUDANÇA, E DÁ A MESMA ORDEM DE ESCRITA DO apply
+	FILE *tmp = tmpfile();
+	if (!tmp)
+		error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "tmpfile");
+
+	struct delta_scan scan = { .src = source, .src_bpb = &source_bpb, .dst = fp, .dst_bpb = bpb };
+	delta_write(&scan, tmp);
+	delta_apply_stream(fp, bpb, tmp, source_path);
+
+	fclose(tmp);
+	fclose(source);
+}
@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <errno.h>
+#include <error.h>
+
+#include "extent.h"
+#include "commands.h"
+
+#define EXTENT_CACHE_SIZE 64
+
+/*
+ * Cache por processo: os mapas mais recentes e a FAT usada para montá-los.
+ * Tudo é descartado se outra imagem (outro FILE*) aparecer. O FILE* é só um
+ * endereço: depois de um fclose() o fopen() seguinte pode devolver o mesmo,
+ * por isso quem fecha a imagem tem que chamar extent_cache_invalidate(0).
+ */
+static struct
+{
+	FILE     *fp;
+	uint32_t *fat;
+	struct fat_extent_map maps[EXTENT_CACHE_SIZE];
+	uint64_t  last_use[EXTENT_CACHE_SIZE];
+	uint64_t  tick;
+} cache;
+
+static void extent_map_free(struct fat_extent_map *map)
+{
+	free(map->extents);
+	memset(map, 0, sizeof(*map));
+}
+
+void extent_cache_invalidate(uint32_t start_cluster)
+{
+	for (int i = 0; i < EXTENT_CACHE_SIZE; i++)
+		if (cache.maps[i].extents && (start_cluster == 0 || cache.maps[i].start_cluster == start_cluster))
+			extent_map_free(&cache.maps[i]);
+
+	if (start_cluster == 0)
+	{
+		free(cache.fat);
+		cache.fat = NULL;
+		cache.fp  = NULL;
+	}
+}
+
+/* Segue a cadeia uma única vez, juntando clusters consecutivos */
+static void extent_map_build(struct fat_bpb *bpb, struct fat_extent_map *map)
+{
+	const uint32_t cluster_width = bpb->bytes_p_sect * bpb->sector_p_clust;
+	size_t capacity = 8;
+
+	map->extents = malloc(capacity * sizeof(struct fat_extent));
+	if (!map->extents)
+		error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar o mapa de extents");
+
+	uint64_t offset  = 0;
+	uint32_t cluster = map->start_cluster;
+	for (uint32_t steps = 0; offset < map->file_size && cluster >= 2 && cluster < FAT32_EOC && steps < fat_entry_count(bpb); steps++)
+	{
+		struct fat_extent *last = map->count ? &map->extents[map->count - 1] : NULL;
+
+		if (last && last->cluster + last->count == cluster)
+			last->count++;
+		else
+		{
+			if (map->count == capacity)
+			{
+				capacity *= 2;
+				map->extents = realloc(map->extents, capacity * sizeof(struct fat_extent));
+				if (!map->extents)
+					error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar o mapa de extents");
+			}
+			map->extents[map->count++] = (struct fat_extent) { .offset = offset, .cluster = cluster, .count = 1 };
+		}
+
+		offset += cluster_width;
+		cluster = fat_next_cluster(cache.fat, bpb, cluster);
+	}
+}
+
+const uint32_t *extent_cache_fat(FILE *fp, struct fat_bpb *bpb)
+{
+	if (cache.fp != fp)
+	{
+		extent_cache_invalidate(0);
+		cache.fp = fp;
+	}
+	if (!cache.fat)
+		cache.fat = fat_load(fp, bpb);
+
+	return cache.fat;
+}
+
+const struct fat_extent_map *extent_map_get(FILE *fp, struct fat_bpb *bpb, const struct fat_dir *entry)
+{
+	extent_cache_fat(fp, bpb);
+
+	uint32_t start = fat_dir_cluster(entry);
+	int victim = 0;
+
+	for (int i = 0; i < EXTENT_CACHE_SIZE; i++)
+	{
+		struct fat_extent_map *map = &cache.maps[i];
+		if (map->extents && map->start_cluster == start && map->file_size == entry->file_size)
+		{
+			cache.last_use[i] = ++cache.tick;
+			return map;
+		}
+		if (!map->extents || (cache.maps[victim].extents && cache.last_use[i] < cache.last_use[victim]))
+			victim = i;
+	}
+
+	struct fat_extent_map *map = &cache.maps[victim];
+	extent_map_free(map);
+	map->start_cluster = start;
+	map->file_size     = entry->file_size;
+	extent_map_build(bpb, map);
+	cache.last_use[victim] = ++cache.tick;
+
+	return map;
+}
+
+/* Último extent que começa em ou antes de `offset` */
+static const struct fat_extent *extent_find(const struct fat_extent_map *map, uint64_t offset)
+{
+	size_t lo = 0, hi = map->count;
+	while (hi - lo > 1)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+		if (map->extents[mid].offset <= offset)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return map->count ? &map->extents[lo] : NULL;
+}
+
+size_t fat_read_at(FILE *fp, struct fat_bpb *bpb, const struct fat_dir *entry, uint64_t offset, void *buf, size_t len)
+{
+	if (offset >= entry->file_size)
+		return 0;
+	len = MIN(len, entry->file_size - offset);
+
+	const uint32_t cluster_width = bpb->bytes_p_sect * bpb->sector_p_clust;
+	const struct fat_extent_map *map = extent_map_get(fp, bpb, entry);
+	const struct fat_extent *extent  = extent_find(map, offset);
+	const struct fat_extent *end     = map->extents + map->count;
+
+	// UMA LEITURA POR EXTENT; A CADEIA NUNCA É PERCORRIDA DE NOVO
+	size_t done = 0;
+	for (; extent && extent < end && done < len; extent++)
+	{
+		uint64_t extent_len = (uint64_t) extent->count * cluster_width;
+		uint64_t within     = offset + done - extent->offset;
+		if (within >= extent_len)
+			break; // cadeia mais curta que file_size
+
+		size_t n = MIN(len - done, extent_len - within);
+		if (read_bytes(fp, bpb_cluster_addr(bpb, extent->cluster) + within, (char *) buf + done, n) == RB_ERROR)
+			break;
+		done += n;
+	}
+
+	return done;
+}
@@ -1,65 +1,66 @@
 #include "fat16.h"
+#include "fat_engine.h"
+#include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include <errno.h>
 #include <error.h>
 #include <err.h>
 
-#define FAT32_CLUSTER_MASK 0x0FFFFFFF // Máscara para considerar apenas os 28 bits alocados
-
 /* Calcula o endereço inicial da FAT */
 uint32_t bpb_faddress(struct fat_bpb *bpb)
 {
     // A área reservada contém [bytes_p_sect] bytes, multiplica por [reserved_sect] para obter o endereço inicial da FAT
-    return bpb->reserved_sect * bpb->bytes_p_sect;
+    return bpb->geo.fat_addr;
 }
 
 /* Calcula o endereço do diretório raiz */
 uint32_t bpb_froot_addr(struct fat_bpb *bpb)
 {
-    // FAT32: Aplica a máscara ao cluster inicial
-    uint32_t root_cluster = bpb->root_cluster & FAT32_CLUSTER_MASK;
-    return bpb_fdata_addr(bpb) + (root_cluster - 2) * bpb->sector_p_clust * bpb->bytes_p_sect;
+    // FAT12/16: região fixa logo após as FATs; FAT32: primeiro cluster do raiz
+    return bpb->geo.root_addr;
 }
 
 /* Calculo do endereço inicial dos dados */
 uint32_t bpb_fdata_addr(struct fat_bpb *bpb)
 {
-    // FAT32
-    return bpb_faddress(bpb) + (bpb->n_fat * bpb->sect_per_fat_32 * bpb->bytes_p_sect);
+    return bpb->geo.data_addr;
 }
 
 /* Calcula a quantidade de setores/blocos de dados (Um setor contém muitos bytes de um arquivo até um limite) */
 uint32_t bpb_fdata_sector_count(struct fat_bpb *bpb)
 {
-    uint32_t total_sectors = bpb->total_sectors_32; // Para FAT32, utiliza-se total_sectors_32
-    uint32_t fat_size = bpb->sect_per_fat_32;       // Para FAT32, utiliza-se sect_per_fat_32
-    uint32_t data_sectors = total_sectors - (bpb->reserved_sect + (bpb->n_fat * fat_size));
-    return data_sectors;
+    return bpb_total_sectors(bpb) - bpb->geo.data_addr / bpb->bytes_p_sect;
 }
 
-/* Calcula a quantidade de setores/blocos de dados (Um setor contém muitos bytes de um arquivo até um limite) */
-static uint32_t bpb_fdata_sector_count_s(struct fat_bpb* bpb)
+/* Calcula a quantidade de clusters de dados (Um cluster contém um ou mais setores) */
+uint32_t bpb_fdata_cluster_count(struct fat_bpb *bpb)
 {
-    uint32_t total_sectors = bpb->total_sectors_32; // Para FAT32
-    return total_sectors - bpb_fdata_addr(bpb) / bpb->bytes_p_sect;
+    return bpb->geo.cluster_count;
 }
 
-/* Calcula a quantidade de clusters de dados (Um cluster contém um ou mais setores) */
-uint32_t bpb_fdata_cluster_count(struct fat_bpb *bpb)
+/* Total de setores: volumes pequenos usam o campo de 16 bits mesmo em FAT32 */
+uint32_t bpb_total_sectors(struct fat_bpb *bpb)
+{
+    return bpb->total_sectors_16 ? bpb->total_sectors_16 : bpb->total_sectors_32;
+}
+
+/* Endereço em disco do início de um cluster de dados */
+uint64_t bpb_cluster_addr(struct fat_bpb *bpb, uint32_t cluster)
 {
-    uint32_t data_sectors = bpb_fdata_sector_count_s(bpb);
-    return data_sectors / bpb->sector_p_clust; // Clusters não precisam de máscara aqui
+    return bpb->geo.data_addr + (uint64_t) (cluster - 2) * bpb->geo.cluster_width;
 }
 
 /*
  * allows reading from a specific offset and writing the data to buff
  * returns RB_ERROR if seeking or reading failed and RB_OK if success
  */
-int read_bytes(FILE *fp, unsigned int offset, void *buff, unsigned int len)
+int read_bytes(FILE *fp, uint64_t offset, void *buff, unsigned int len)
 {
-    if (fseek(fp, offset, SEEK_SET) != 0)
+    if (fseek(fp, (long) offset, SEEK_SET) != 0)
     {
-        error_at_line(0, errno, __FILE__, __LINE__, "warning: error when seeking to %u", offset);
+        error_at_line(0, errno, __FILE__, __LINE__, "warning: error when seeking to %llu", (unsigned long long) offset);
         return RB_ERROR;
     }
     if (fread(buff, 1, len, fp) != len)
@@ -71,14 +72,497 @@ int read_bytes(FILE *fp, unsigned int offset, void *buff, unsigned int len)
     return RB_OK;
 }
 
-/* read FAT32's bios parameter block */
+/*
+ * Variante e geometria do volume, calculadas uma vez. Como no Linux, um BPB
+ * sem setores por FAT de 16 bits é FAT32; nos outros a contagem de clusters
+ * separa FAT12 de FAT16.
+ */
+static void fat_geometry_init(struct fat_bpb *bpb)
+{
+    struct fat_geometry geo = { 0 };
+    bool fat32 = bpb->sect_per_fat_16 == 0;
+
+    geo.fat_sectors   = fat32 ? bpb->sect_per_fat_32 : bpb->sect_per_fat_16;
+    geo.fat_addr      = bpb->reserved_sect * bpb->bytes_p_sect;
+    geo.root_size     = fat32 ? 0 : bpb->root_entry_count * sizeof(struct fat_dir);
+    geo.cluster_width = bpb->bytes_p_sect * bpb->sector_p_clust;
+
+    // O raiz fixo ocupa setores inteiros
+    uint32_t root_sectors = (geo.root_size + bpb->bytes_p_sect - 1) / bpb->bytes_p_sect;
+    uint32_t fats_end     = geo.fat_addr + bpb->n_fat * geo.fat_sectors * bpb->bytes_p_sect;
+
+    geo.data_addr     = fats_end + root_sectors * bpb->bytes_p_sect;
+    geo.cluster_count = (bpb_total_sectors(bpb) - geo.data_addr / bpb->bytes_p_sect) / bpb->sector_p_clust;
+
+    if (fat32)
+        geo.engine = &fat32_engine;
+    else if (geo.cluster_count < 4085)
+        geo.engine = &fat12_engine;
+    else
+        geo.engine = &fat16_engine;
+
+    // FAT32: Aplica a máscara ao cluster inicial
+    geo.root_addr = fat32 ? geo.data_addr + ((bpb->root_cluster & FAT32_CLUSTER_MASK) - 2) * geo.cluster_width : fats_end;
+
+    // Uma FAT maior que o volume tem entradas que não apontam para cluster nenhum
+    uint32_t capacity = (uint32_t) ((uint64_t) geo.fat_sectors * bpb->bytes_p_sect * 8 / geo.engine->bits);
+    geo.entry_count  = capacity < geo.cluster_count + 2 ? capacity : geo.cluster_count + 2;
+
+    // COM O BIT 7 DE ext_flags (SÓ FAT32) SÓ A FAT DE NÚMERO (ext_flags & 0xF) ESTÁ ATIVA
+    geo.fat_first  = 0;
+    geo.fat_copies = bpb->n_fat;
+    if (fat32 && (bpb->ext_flags & 0x80))
+        geo.fat_first = bpb->ext_flags & 0x0F, geo.fat_copies = 1;
+
+    bpb->geo = geo;
+}
+
+/* read the bios parameter block and pick the FAT variant */
 void rfat(FILE *fp, struct fat_bpb *bpb)
 {
-    read_bytes(fp, 0x0, bpb, sizeof(struct fat_bpb));
+    if (read_bytes(fp, 0x0, bpb, offsetof(struct fat_bpb, geo)) == RB_ERROR)
+        exit(EXIT_FAILURE);
 
-    // Verifica se é FAT32
-    if (bpb->sect_per_fat_16 != 0 || bpb->sect_per_fat_32 == 0) {
-        fprintf(stderr, "Erro: O sistema de arquivos não é FAT32.\n");
+    // Verifica se é um sistema FAT
+    if (bpb->bytes_p_sect < sizeof(struct fat_dir) || bpb->sector_p_clust == 0 || bpb->n_fat == 0
+        || (bpb->sect_per_fat_16 == 0 && bpb->sect_per_fat_32 == 0)) {
+        fprintf(stderr, "Erro: O sistema de arquivos não é FAT.\n");
         exit(EXIT_FAILURE);
     }
+
+    fat_geometry_init(bpb);
+}
+
+/* Quantas entradas válidas a FAT tem */
+uint32_t fat_entry_count(struct fat_bpb *bpb)
+{
+    return bpb->geo.entry_count;
+}
+
+/*
+ * Lê a primeira cópia ativa da FAT inteira; o chamador libera com free().
+ * A tabela cobre todos os setores da FAT, mesmo além de fat_entry_count().
+ */
+uint32_t *fat_load(FILE *fp, struct fat_bpb *bpb)
+{
+    const struct fat_engine *engine = bpb->geo.engine;
+    uint32_t bytes    = bpb->geo.fat_sectors * bpb->bytes_p_sect;
+    uint32_t capacity = (uint32_t) ((uint64_t) bytes * 8 / engine->bits);
+    uint64_t address  = bpb->geo.fat_addr + (uint64_t) bpb->geo.fat_first * bytes;
+    uint32_t *fat     = calloc(capacity, sizeof(uint32_t));
+
+    if (!fat)
+        error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar memória para a FAT");
+
+    // FAT32 JÁ ESTÁ NO FORMATO DA MEMÓRIA; AS OUTRAS PASSAM PELO MOTOR
+    if (engine->bits == 32)
+    {
+        if (read_bytes(fp, address, fat, bytes) == RB_ERROR)
+            error_at_line(EXIT_FAILURE, EIO, __FILE__, __LINE__, "erro ao ler a FAT");
+        return fat;
+    }
+
+    uint8_t *raw = malloc(bytes);
+    if (!raw)
+        error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar memória para a FAT");
+
+    if (read_bytes(fp, address, raw, bytes) == RB_ERROR)
+        error_at_line(EXIT_FAILURE, EIO, __FILE__, __LINE__, "erro ao ler a FAT");
+
+    engine->decode(raw, fat, bpb->geo.entry_count);
+    free(raw);
+
+    return fat;
+}
+
+/*
+ * Próximo cluster da cadeia, ou FAT32_EOC quando ela termina. Entradas fora
+ * da tabela, livres ou ruins também encerram a cadeia, para uma imagem
+ * corrompida não fazer ninguém ler lixo.
+ */
+uint32_t fat_next_cluster(const uint32_t *fat, struct fat_bpb *bpb, uint32_t cluster)
+{
+    if (cluster < 2 || cluster >= fat_entry_count(bpb))
+        return FAT32_EOC;
+
+    uint32_t next = fat[cluster] & FAT32_CLUSTER_MASK;
+    if (next < 2 || next >= FAT32_BAD || next >= fat_entry_count(bpb))
+        return FAT32_EOC;
+
+    return next;
+}
+
+/* Cluster inicial de uma entrada: em FAT32 a parte alta fica em outro campo */
+uint32_t fat_dir_cluster(const struct fat_dir *entry)
+{
+    return ((uint32_t) entry->starting_cluster_hi << 16 | entry->starting_cluster) & FAT32_CLUSTER_MASK;
+}
+
+/* "ARQ     TXT" → "ARQ.TXT" */
+static void fat_format_name(const unsigned char name[FAT16STR_SIZE], char *out)
+{
+    int n = 0;
+    for (int i = 0; i < 8 && name[i] != ' '; i++)
+        out[n++] = (char) name[i];
+
+    if (name[8] != ' ')
+    {
+        out[n++] = '.';
+        for (int i = 8; i < FAT16STR_SIZE && name[i] != ' '; i++)
+            out[n++] = (char) name[i];
+    }
+    out[n] = '\0';
+}
+
+/* Limite de profundidade contra ciclos em imagens corrompidas */
+#define FAT_WALK_DEPTH 32
+
+static void fat_walk_dir(FILE *fp, struct fat_bpb *bpb, const uint32_t *fat, uint32_t cluster,
+                         const char *prefix, int depth, fat_visit_fn visit, void *arg);
+
+/* Visita as entradas de um bloco do diretório; false ao achar o fim dele */
+static bool fat_walk_entries(FILE *fp, struct fat_bpb *bpb, const uint32_t *fat, struct fat_dir *dir, uint32_t entries,
+                             uint64_t address, const char *prefix, int depth, fat_visit_fn visit, void *arg)
+{
+    for (uint32_t i = 0; i < entries; i++)
+    {
+        struct fat_dir *entry = &dir[i];
+
+        if (entry->name[0] == 0)
+            return false; // fim do diretório
+        if (entry->name[0] == DIR_FREE_ENTRY || entry->attr == DIR_ATTR_LFN
+            || (entry->attr & DIR_ATTR_VOLUMEID) || entry->name[0] == '.')
+            continue;
+
+        char name[FAT16STR_SIZE_WNULL + 1], path[FAT_PATH_MAX];
+        fat_format_name(entry->name, name);
+        snprintf(path, sizeof(path), "%s%s%s", prefix, *prefix ? "/" : "", name);
+
+        visit(path, entry, address + i * sizeof(struct fat_dir), arg);
+
+        if ((entry->attr & DIR_ATTR_DIRECTORY) && depth < FAT_WALK_DEPTH && fat_dir_cluster(entry) >= 2)
+            fat_walk_dir(fp, bpb, fat, fat_dir_cluster(entry), path, depth + 1, visit, arg);
+    }
+
+    return true;
+}
+
+static void fat_walk_dir(FILE *fp, struct fat_bpb *bpb, const uint32_t *fat, uint32_t cluster,
+                         const char *prefix, int depth, fat_visit_fn visit, void *arg)
+{
+    const uint32_t cluster_width = bpb->geo.cluster_width;
+    const uint32_t entries = cluster_width / sizeof(struct fat_dir);
+    struct fat_dir *dir = malloc(cluster_width);
+
+    if (!dir)
+        error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar memória para o diretório");
+
+    // A cadeia nunca é maior que a FAT; passar disso é um ciclo
+    for (uint32_t steps = 0; cluster < FAT32_EOC && steps < fat_entry_count(bpb); steps++)
+    {
+        uint64_t address = bpb_cluster_addr(bpb, cluster);
+        if (read_bytes(fp, address, dir, cluster_width) == RB_ERROR)
+            error_at_line(EXIT_FAILURE, EIO, __FILE__, __LINE__, "erro ao ler struct fat_dir");
+
+        if (!fat_walk_entries(fp, bpb, fat, dir, entries, address, prefix, depth, visit, arg))
+            break;
+
+        cluster = fat_next_cluster(fat, bpb, cluster);
+    }
+
+    free(dir);
+}
+
+/* FAT12/16: o raiz é uma região fixa, fora da área de dados */
+static struct fat_dir *fat_read_fixed_root(FILE *fp, struct fat_bpb *bpb)
+{
+    struct fat_dir *root = malloc(bpb->geo.root_size);
+
+    if (!root)
+        error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar memória para o diretório");
+
+    if (read_bytes(fp, bpb->geo.root_addr, root, bpb->geo.root_size) == RB_ERROR)
+        error_at_line(EXIT_FAILURE, EIO, __FILE__, __LINE__, "erro ao ler struct fat_dir");
+
+    return root;
+}
+
+void fat_walk(FILE *fp, struct fat_bpb *bpb, const uint32_t *fat, fat_visit_fn visit, void *arg)
+{
+    if (bpb->geo.root_size == 0)
+    {
+        fat_walk_dir(fp, bpb, fat, bpb->root_cluster & FAT32_CLUSTER_MASK, "", 0, visit, arg);
+        return;
+    }
+
+    struct fat_dir *root = fat_read_fixed_root(fp, bpb);
+    fat_walk_entries(fp, bpb, fat, root, bpb->geo.root_size / sizeof(struct fat_dir), bpb->geo.root_addr, "", 0, visit, arg);
+    free(root);
+}
+
+bool fat_root_free_entry(FILE *fp, struct fat_bpb *bpb, const uint32_t *fat, uint64_t *address)
+{
+    bool fixed = bpb->geo.root_size != 0;
+    uint32_t size    = fixed ? bpb->geo.root_size : bpb->geo.cluster_width;
+    uint32_t cluster = fixed ? 0 : bpb->root_cluster & FAT32_CLUSTER_MASK;
+    struct fat_dir *dir = malloc(size);
+
+    if (!dir)
+        error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar memória para o diretório");
+
+    // O RAIZ FIXO É LIDO DE UMA VEZ; O DE FAT32 CLUSTER A CLUSTER
+    for (uint32_t steps = 0; steps < fat_entry_count(bpb); steps++)
+    {
+        uint64_t base = fixed ? bpb->geo.root_addr : bpb_cluster_addr(bpb, cluster);
+        if (read_bytes(fp, base, dir, size) == RB_ERROR)
+            break;
+
+        for (uint32_t i = 0; i < size / sizeof(struct fat_dir); i++)
+            if (dir[i].name[0] == DIR_FREE_ENTRY || dir[i].name[0] == '\0')
+            {
+                *address = base + i * sizeof(struct fat_dir);
+                free(dir);
+                return true;
+            }
+
+        if (fixed || (cluster = fat_next_cluster(fat, bpb, cluster)) >= FAT32_EOC)
+            break;
+    }
+
+    free(dir);
+    return false;
+}
+
+uint32_t fat_find_free(const uint32_t *fat, struct fat_bpb *bpb, uint32_t from)
+{
+    const uint32_t count = bpb->geo.entry_count;
+
+    if (from < 2 || from >= count)
+        from = 2;
+
+    // A TABELA EM MEMÓRIA É IGUAL PARA TODAS AS VARIANTES: UM LAÇO SÓ
+    for (uint32_t cluster = from; cluster < count; cluster++)
+        if ((fat[cluster] & FAT32_CLUSTER_MASK) == 0)
+            return cluster;
+    for (uint32_t cluster = 2; cluster < from; cluster++)
+        if ((fat[cluster] & FAT32_CLUSTER_MASK) == 0)
+            return cluster;
+
+    return 0;
+}
+
+static int fat_compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+void fat_store(FILE *fp, struct fat_bpb *bpb, const uint32_t *fat, const uint32_t *clusters, size_t count)
+{
+    if (count == 0)
+        return;
+
+    const struct fat_engine *engine = bpb->geo.engine;
+    const uint32_t bps       = bpb->bytes_p_sect;
+    const uint32_t fat_bytes = bpb->geo.fat_sectors * bps;
+
+    // CLUSTERS ORDENADOS: ENTRADAS VIZINHAS FICAM NOS MESMOS SETORES
+    uint32_t *sorted = malloc(count * sizeof(uint32_t));
+
+    if (!sorted)
+        error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar memória para a FAT");
+
+    memcpy(sorted, clusters, count * sizeof(uint32_t));
+    qsort(sorted, count, sizeof(uint32_t), fat_compare_u32);
+
+    // FAT32 JÁ ESTÁ NO FORMATO DO DISCO; FAT12/16 (NO MÁXIMO 128 KiB) SÃO
+    // LIDAS INTEIRAS E SÓ AS ENTRADAS ALTERADAS SÃO TROCADAS
+    const uint8_t *image = (const uint8_t *) fat;
+    uint8_t *raw = NULL;
+
+    if (engine->bits != 32)
+    {
+        raw = malloc(fat_bytes);
+        if (!raw)
+            error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar memória para a FAT");
+
+        if (read_bytes(fp, bpb_faddress(bpb) + (uint64_t) bpb->geo.fat_first * fat_bytes, raw, fat_bytes) == RB_ERROR)
+            error_at_line(EXIT_FAILURE, EIO, __FILE__, __LINE__, "erro ao ler a FAT");
+
+        for (size_t k = 0; k < count; k++)
+            engine->encode(raw, sorted[k], fat[sorted[k]]);
+        image = raw;
+    }
+
+    for (size_t i = 0; i < count;)
+    {
+        // UMA ESCRITA POR SEQUÊNCIA DE SETORES CONSECUTIVOS (EM FAT12 UMA ENTRADA PODE CRUZAR DOIS)
+        uint32_t first = fat_entry_first_byte(engine, sorted[i]) / bps;
+        uint32_t last  = fat_entry_last_byte(engine, sorted[i]) / bps;
+        size_t j = i + 1;
+
+        while (j < count && fat_entry_first_byte(engine, sorted[j]) / bps <= last + 1)
+        {
+            uint32_t end = fat_entry_last_byte(engine, sorted[j]) / bps;
+            last = end > last ? end : last;
+            j++;
+        }
+
+        uint32_t run = last - first + 1;
+        const uint8_t *data = image + (uint64_t) first * bps;
+
+        for (uint8_t copy = bpb->geo.fat_first; copy < bpb->geo.fat_first + bpb->geo.fat_copies; copy++)
+        {
+            uint64_t address = bpb_faddress(bpb) + (uint64_t) copy * fat_bytes + (uint64_t) first * bps;
+
+            if (fseek(fp, (long) address, SEEK_SET) != 0)
+                error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao posicionar o ponteiro do arquivo");
+
+            if (fwrite(data, bps, run, fp) != run)
+                error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao escrever a FAT");
+        }
+
+        i = j;
+    }
+
+    free(raw);
+    free(sorted);
+}
+
+#define FSINFO_LEAD_SIG   0x41615252
+#define FSINFO_STRUCT_SIG 0x61417272
+#define FSINFO_UNKNOWN    0xFFFFFFFF
+
+void fsinfo_update(FILE *fp, struct fat_bpb *bpb, int64_t free_delta, uint32_t next_free)
+{
+    // SÓ FAT32 TEM FSINFO; EM FAT12/16 ESSES BYTES SÃO O RÓTULO DO VOLUME
+    if (bpb->geo.engine != &fat32_engine || bpb->fs_info == 0 || bpb->fs_info == 0xFFFF)
+        return;
+
+    uint64_t address = (uint64_t) bpb->fs_info * bpb->bytes_p_sect;
+    uint32_t lead, info[3]; // assinatura, clusters livres, próximo livre
+
+    if (read_bytes(fp, address, &lead, sizeof(lead)) == RB_ERROR
+        || read_bytes(fp, address + 484, info, sizeof(info)) == RB_ERROR)
+        return;
+
+    // SEM AS ASSINATURAS O SETOR NÃO É UM FSINFO; MELHOR NÃO MEXER
+    if (lead != FSINFO_LEAD_SIG || info[0] != FSINFO_STRUCT_SIG)
+        return;
+
+    if (info[1] != FSINFO_UNKNOWN)
+        info[1] = (uint32_t) ((int64_t) info[1] + free_delta);
+    if (next_free >= 2 && (info[2] == FSINFO_UNKNOWN || next_free < info[2]))
+        info[2] = next_free;
+
+    if (fseek(fp, (long) (address + 488), SEEK_SET) != 0 || fwrite(&info[1], sizeof(uint32_t), 2, fp) != 2)
+        error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao escrever o FSInfo");
+}
+
+/*
+ * Procura `name` (os `length` primeiros bytes) nas `entries` entradas de um
+ * bloco do diretório. Retorna 1 se achou, 0 ao chegar no fim do diretório e
+ * -1 se o diretório continua no próximo bloco.
+ */
+static int fat_find_entries(const struct fat_dir *dir, uint32_t entries, uint64_t address,
+                            const char *name, size_t length, struct fat_dir *entry, uint64_t *found_at)
+{
+    for (uint32_t i = 0; i < entries; i++)
+    {
+        const struct fat_dir *candidate = &dir[i];
+
+        if (candidate->name[0] == 0)
+            return 0;
+        if (candidate->name[0] == DIR_FREE_ENTRY || candidate->attr == DIR_ATTR_LFN
+            || (candidate->attr & DIR_ATTR_VOLUMEID) || candidate->name[0] == '.')
+            continue;
+
+        char formatted[FAT16STR_SIZE_WNULL + 1];
+        fat_format_name(candidate->name, formatted);
+        if (strlen(formatted) != length || strncasecmp(formatted, name, length) != 0)
+            continue;
+
+        *entry    = *candidate;
+        *found_at = address + i * sizeof(struct fat_dir);
+        return 1;
+    }
+
+    return -1;
+}
+
+/* Procura um nome em um diretório: o raiz fixo (cluster 0 em FAT12/16) ou a cadeia de `cluster` */
+static bool fat_find_in_dir(FILE *fp, struct fat_bpb *bpb, const uint32_t *fat, uint32_t cluster,
+                            const char *name, size_t length, struct fat_dir *entry, uint64_t *found_at)
+{
+    if (cluster == 0)
+    {
+        struct fat_dir *root = fat_read_fixed_root(fp, bpb);
+        int result = fat_find_entries(root, bpb->geo.root_size / sizeof(struct fat_dir), bpb->geo.root_addr,
+                                      name, length, entry, found_at);
+        free(root);
+        return result == 1;
+    }
+
+    const uint32_t cluster_width = bpb->geo.cluster_width;
+    struct fat_dir *dir = malloc(cluster_width);
+    int result = -1;
+
+    if (!dir)
+        error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar memória para o diretório");
+
+    // Um cluster por vez, parando no nome ou no fim; passar do tamanho da FAT é um ciclo
+    for (uint32_t steps = 0; result < 0 && cluster < FAT32_EOC && steps < fat_entry_count(bpb); steps++)
+    {
+        uint64_t address = bpb_cluster_addr(bpb, cluster);
+        if (read_bytes(fp, address, dir, cluster_width) == RB_ERROR)
+            error_at_line(EXIT_FAILURE, EIO, __FILE__, __LINE__, "erro ao ler struct fat_dir");
+
+        result = fat_find_entries(dir, cluster_width / sizeof(struct fat_dir), address, name, length, entry, found_at);
+        cluster = fat_next_cluster(fat, bpb, cluster);
+    }
+
+    free(dir);
+    return result == 1;
+}
+
+/*
+ * Resolve o caminho um componente por vez: só o diretório de cada nome
+ * intermediário é lido, e a busca para no último nome.
+ */
+bool fat_find(FILE *fp, struct fat_bpb *bpb, const uint32_t *fat, const char *path, struct fat_dir *entry, uint64_t *address)
+{
+    uint32_t cluster = bpb->geo.root_size ? 0 : bpb->root_cluster & FAT32_CLUSTER_MASK;
+    struct fat_dir found;
+    uint64_t found_at = 0;
+    bool any = false;
+
+    for (int depth = 0; *path; depth++)
+    {
+        size_t length = strcspn(path, "/");
+        if (length == 0)
+        {
+            path++; // barras repetidas ou no começo
+            continue;
+        }
+
+        // Um nome intermediário tem que ser um diretório com cadeia própria
+        if (depth > FAT_WALK_DEPTH || (any && (!(found.attr & DIR_ATTR_DIRECTORY) || fat_dir_cluster(&found) < 2)))
+            return false;
+        if (any)
+            cluster = fat_dir_cluster(&found);
+
+        if (!fat_find_in_dir(fp, bpb, fat, cluster, path, length, &found, &found_at))
+            return false;
+
+        any = true;
+        path += length;
+    }
+
+    if (!any)
+        return false;
+
+    *entry = found;
+    if (address)
+        *address = found_at;
+    return true;
 }
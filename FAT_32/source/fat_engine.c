@@ -0,0 +1,94 @@
+#include <string.h>
+
+#include "fat_engine.h"
+
+///
+/// LEITURA E ESCRITA DE UMA ENTRADA, POR LARGURA
+
+/* FAT12: duas entradas a cada três bytes; clusters ímpares usam os 12 bits altos */
+static inline uint32_t fat12_get(const uint8_t *raw, uint32_t cluster)
+{
+	uint32_t offset = cluster + cluster / 2;
+	uint32_t pair   = raw[offset] | (uint32_t) raw[offset + 1] << 8;
+	return cluster & 1 ? pair >> 4 : pair & 0x0FFF;
+}
+
+static inline void fat12_put(uint8_t *raw, uint32_t cluster, uint32_t value)
+{
+	uint32_t offset = cluster + cluster / 2;
+	if (cluster & 1)
+	{
+		raw[offset]     = (uint8_t) ((raw[offset] & 0x0F) | (value << 4 & 0xF0));
+		raw[offset + 1] = (uint8_t) (value >> 4);
+	}
+	else
+	{
+		raw[offset]     = (uint8_t) value;
+		raw[offset + 1] = (uint8_t) ((raw[offset + 1] & 0xF0) | (value >> 8 & 0x0F));
+	}
+}
+
+static inline uint32_t fat16_get(const uint8_t *raw, uint32_t cluster)
+{
+	uint16_t value;
+	memcpy(&value, raw + (size_t) cluster * 2, sizeof(value));
+	return value;
+}
+
+static inline void fat16_put(uint8_t *raw, uint32_t cluster, uint32_t value)
+{
+	uint16_t entry = (uint16_t) value;
+	memcpy(raw + (size_t) cluster * 2, &entry, sizeof(entry));
+}
+
+static inline uint32_t fat32_get(const uint8_t *raw, uint32_t cluster)
+{
+	uint32_t value;
+	memcpy(&value, raw + (size_t) cluster * 4, sizeof(value));
+	return value;
+}
+
+static inline void fat32_put(uint8_t *raw, uint32_t cluster, uint32_t value)
+{
+	memcpy(raw + (size_t) cluster * 4, &value, sizeof(value));
+}
+
+///
+/// MOTORES
+///
+/// Em FAT32 a entrada em memória é a própria entrada em disco (inclusive os
+/// 4 bits altos reservados); nas outras, fim de cadeia e cluster ruim são
+/// traduzidos para os valores do FAT32 e de volta.
+
+#define FAT_ENGINE(BITS, MASK, EOC_MIN, BAD)                                              \
+	static void fat##BITS##_decode(const uint8_t *raw, uint32_t *fat, uint32_t count)     \
+	{                                                                                     \
+		for (uint32_t cluster = 0; cluster < count; cluster++)                            \
+		{                                                                                 \
+			uint32_t value = fat##BITS##_get(raw, cluster);                               \
+			if (BITS < 32 && value >= (EOC_MIN))                                          \
+				value = FAT32_CLUSTER_MASK;                                               \
+			else if (BITS < 32 && value == (BAD))                                         \
+				value = FAT32_BAD;                                                        \
+			fat[cluster] = value;                                                         \
+		}                                                                                 \
+	}                                                                                     \
+                                                                                          \
+	static void fat##BITS##_encode(uint8_t *raw, uint32_t cluster, uint32_t value)        \
+	{                                                                                     \
+		if (BITS < 32 && (value & FAT32_CLUSTER_MASK) >= FAT32_EOC)                       \
+			value = (MASK);                                                               \
+		else if (BITS < 32 && (value & FAT32_CLUSTER_MASK) == FAT32_BAD)                  \
+			value = (BAD);                                                                \
+		fat##BITS##_put(raw, cluster, value);                                             \
+	}                                                                                     \
+                                                                                          \
+	const struct fat_engine fat##BITS##_engine =                                          \
+	{                                                                                     \
+		.bits = BITS, .mask = MASK, .eoc_min = EOC_MIN, .bad = BAD,                       \
+		.decode = fat##BITS##_decode, .encode = fat##BITS##_encode,                       \
+	};
+
+FAT_ENGINE(12, 0x0FFF,     0x0FF8,     0x0FF7)
+FAT_ENGINE(16, 0xFFFF,     0xFFF8,     0xFFF7)
+FAT_ENGINE(32, 0x0FFFFFFF, FAT32_EOC,  FAT32_BAD)
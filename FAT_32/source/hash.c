@@ -0,0 +1,175 @@
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "hash.h"
+
+///
+/// CRC32C
+
+#define CRC32C_POLY 0x82F63B78 // polinômio refletido
+
+static uint32_t crc32c_table[256];
+
+static void crc32c_init_table(void)
+{
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		uint32_t crc = i;
+		for (int k = 0; k < 8; k++)
+			crc = (crc >> 1) ^ (CRC32C_POLY & (0u - (crc & 1)));
+		crc32c_table[i] = crc;
+	}
+}
+
+static uint32_t crc32c_sw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	while (len--)
+		crc = crc32c_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	uint64_t c = crc;
+
+	// ALINHA, DEPOIS 8 BYTES POR INSTRUÇÃO
+	while (len > 0 && ((uintptr_t) p & 7))
+		c = _mm_crc32_u8((uint32_t) c, *p++), len--;
+	for (; len >= 8; p += 8, len -= 8)
+	{
+		uint64_t word;
+		memcpy(&word, p, 8);
+		c = _mm_crc32_u64(c, word);
+	}
+	while (len--)
+		c = _mm_crc32_u8((uint32_t) c, *p++);
+
+	return (uint32_t) c;
+}
+#endif
+
+static bool crc32c_hw_available;
+
+static void crc32c_detect(void)
+{
+#if defined(__x86_64__)
+	crc32c_hw_available = __builtin_cpu_supports("sse4.2");
+#endif
+	if (!crc32c_hw_available)
+		crc32c_init_table();
+}
+
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len)
+{
+	static pthread_once_t once = PTHREAD_ONCE_INIT;
+	pthread_once(&once, crc32c_detect);
+
+	crc = ~crc;
+#if defined(__x86_64__)
+	if (crc32c_hw_available)
+		return ~crc32c_hw(crc, buf, len);
+#endif
+	return ~crc32c_sw(crc, buf, len);
+}
+
+///
+/// SHA-256 (FIPS 180-4)
+
+static const uint32_t sha256_k[64] =
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(uint32_t state[8], const uint8_t block[64])
+{
+	uint32_t w[64];
+	for (int i = 0; i < 16; i++)
+		w[i] = (uint32_t) block[4 * i] << 24 | (uint32_t) block[4 * i + 1] << 16
+		     | (uint32_t) block[4 * i + 2] << 8 | block[4 * i + 3];
+	for (int i = 16; i < 64; i++)
+	{
+		uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+	uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+	for (int i = 0; i < 64; i++)
+	{
+		uint32_t t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+		uint32_t t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+		h = g, g = f, f = e, e = d + t1;
+		d = c, c = b, b = a, a = t1 + t2;
+	}
+
+	state[0] += a, state[1] += b, state[2] += c, state[3] += d;
+	state[4] += e, state[5] += f, state[6] += g, state[7] += h;
+}
+
+void sha256_init(struct sha256_ctx *ctx)
+{
+	static const uint32_t initial[8] =
+	{
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+	};
+	memcpy(ctx->state, initial, sizeof(initial));
+	ctx->length = 0;
+	ctx->used   = 0;
+}
+
+void sha256_update(struct sha256_ctx *ctx, const void *buf, size_t len)
+{
+	const uint8_t *p = buf;
+	ctx->length += len;
+
+	if (ctx->used > 0)
+	{
+		size_t take = 64 - ctx->used < len ? 64 - ctx->used : len;
+		memcpy(ctx->block + ctx->used, p, take);
+		ctx->used += take, p += take, len -= take;
+		if (ctx->used < 64)
+			return;
+		sha256_block(ctx->state, ctx->block);
+		ctx->used = 0;
+	}
+
+	for (; len >= 64; p += 64, len -= 64)
+		sha256_block(ctx->state, p);
+
+	memcpy(ctx->block, p, len);
+	ctx->used = len;
+}
+
+void sha256_final(struct sha256_ctx *ctx, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+	uint64_t bits = ctx->length * 8;
+	uint8_t pad[72] = { 0x80 };
+	size_t pad_len = (ctx->used < 56 ? 56 : 120) - ctx->used;
+
+	for (int i = 0; i < 8; i++)
+		pad[pad_len + i] = (uint8_t) (bits >> (56 - 8 * i));
+	sha256_update(ctx, pad, pad_len + 8);
+
+	for (int i = 0; i < 8; i++)
+	{
+		digest[4 * i]     = (uint8_t) (ctx->state[i] >> 24);
+		digest[4 * i + 1] = (uint8_t) (ctx->state[i] >> 16);
+		digest[4 * i + 2] = (uint8_t) (ctx->state[i] >> 8);
+		digest[4 * i + 3] = (uint8_t) ctx->state[i];
+	}
+}
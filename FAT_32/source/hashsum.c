@@ -0,0 +1,216 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <errno.h>
+#include <error.h>
+
+#include "commands.h"
+#include "fat16.h"
+#include "hash.h"
+
+#define HASHSUM_BUFFER (1024 * 1024)
+#define HASHSUM_MAX_THREADS 64
+
+struct hashsum_file
+{
+	char     path[FAT_PATH_MAX];
+	uint32_t cluster;
+	uint32_t size;
+	uint32_t crc;
+	uint8_t  sha[SHA256_DIGEST_SIZE];
+	bool     truncated; // a cadeia acabou antes de file_size
+};
+
+struct hashsum_list
+{
+	struct hashsum_file *files;
+	size_t count, capacity;
+};
+
+struct hashsum_ctx
+{
+	FILE                *fp;
+	struct fat_bpb      *bpb;
+	const uint32_t      *fat;
+	struct hashsum_list *list;
+	bool                 sha256;
+	atomic_size_t        next; // próximo arquivo a ser pego por uma thread
+};
+
+static void hashsum_collect(const char *path, const struct fat_dir *entry, uint64_t address, void *arg)
+{
+	struct hashsum_list *list = arg;
+	(void) address;
+
+	if (entry->attr & DIR_ATTR_DIRECTORY)
+		return;
+
+	if (list->count == list->capacity)
+	{
+		list->capacity = list->capacity ? list->capacity * 2 : 64;
+		list->files = realloc(list->files, list->capacity * sizeof(struct hashsum_file));
+		if (!list->files)
+			error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar a lista de arquivos");
+	}
+
+	struct hashsum_file *f = &list->files[list->count++];
+	memset(f, 0, sizeof(*f));
+	snprintf(f->path, sizeof(f->path), "%s", path);
+	f->cluster = fat_dir_cluster(entry);
+	f->size    = entry->file_size;
+}
+
+/*
+ * Segue a cadeia do arquivo juntando clusters consecutivos numa só leitura.
+ * O FILE* é compartilhado entre as threads: cada fseek+fread acontece com o
+ * arquivo travado (flockfile), só o cálculo dos hashes roda em paralelo.
+ */
+static void hashsum_file(struct hashsum_ctx *ctx, struct hashsum_file *f, uint8_t *buffer)
+{
+	const uint32_t cluster_width = ctx->bpb->bytes_p_sect * ctx->bpb->sector_p_clust;
+	uint32_t remaining = f->size;
+	uint32_t cluster   = f->cluster;
+	struct sha256_ctx sha;
+
+	sha256_init(&sha);
+	f->crc = 0;
+
+	while (remaining > 0 && cluster >= 2 && cluster < FAT32_EOC)
+	{
+		uint32_t first = cluster, count = 1;
+		while ((uint64_t) count * cluster_width < remaining && (count + 1) * cluster_width <= HASHSUM_BUFFER)
+		{
+			uint32_t next = fat_next_cluster(ctx->fat, ctx->bpb, cluster);
+			if (next != cluster + 1)
+				break;
+			cluster = next, count++;
+		}
+
+		uint32_t len = MIN(count * cluster_width, remaining);
+
+		flockfile(ctx->fp);
+		int status = read_bytes(ctx->fp, bpb_cluster_addr(ctx->bpb, first), buffer, len);
+		funlockfile(ctx->fp);
+
+		if (status == RB_ERROR)
+			error_at_line(EXIT_FAILURE, EIO, __FILE__, __LINE__, "erro ao ler %s", f->path);
+
+		f->crc = crc32c(f->crc, buffer, len);
+		if (ctx->sha256)
+			sha256_update(&sha, buffer, len);
+
+		remaining -= len;
+		cluster = fat_next_cluster(ctx->fat, ctx->bpb, cluster);
+	}
+
+	f->truncated = remaining > 0;
+	if (ctx->sha256)
+		sha256_final(&sha, f->sha);
+}
+
+static void *hashsum_worker(void *arg)
+{
+	struct hashsum_ctx *ctx = arg;
+	uint8_t *buffer = malloc(HASHSUM_BUFFER);
+
+	if (!buffer)
+		error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar buffer de leitura");
+
+	size_t i;
+	while ((i = atomic_fetch_add(&ctx->next, 1)) < ctx->list->count)
+		hashsum_file(ctx, &ctx->list->files[i], buffer);
+
+	free(buffer);
+	return NULL;
+}
+
+static int hashsum_by_path(const void *a, const void *b)
+{
+	return strcmp(((const struct hashsum_file *) a)->path, ((const struct hashsum_file *) b)->path);
+}
+
+static int hashsum_by_content(const void *a, const void *b)
+{
+	const struct hashsum_file *x = a, *y = b;
+	int c = memcmp(x->sha, y->sha, SHA256_DIGEST_SIZE);
+	if (c == 0 && x->size != y->size)
+		c = x->size < y->size ? -1 : 1;
+	return c ? c : strcmp(x->path, y->path);
+}
+
+static bool hashsum_same(const struct hashsum_file *x, const struct hashsum_file *y)
+{
+	return x->size == y->size && memcmp(x->sha, y->sha, SHA256_DIGEST_SIZE) == 0;
+}
+
+static void hashsum_print(const struct hashsum_file *f, bool sha256)
+{
+	printf("%08x\t", f->crc);
+	if (sha256)
+	{
+		for (int i = 0; i < SHA256_DIGEST_SIZE; i++)
+			printf("%02x", f->sha[i]);
+		printf("\t");
+	}
+	printf("%u\t%s\n", f->size, f->path);
+}
+
+void hashsum(FILE* fp, struct fat_bpb* bpb, struct hashsum_opts* opts)
+{
+	// DUPLICATAS SÃO DECIDIDAS PELO SHA-256; SÓ O CRC DARIA FALSOS POSITIVOS
+	bool sha256 = opts->sha256 || opts->dups;
+
+	uint32_t *fat = fat_load(fp, bpb);
+	struct hashsum_list list = { 0 };
+	fat_walk(fp, bpb, fat, hashsum_collect, &list);
+
+	// THREADS DE HASH
+	struct hashsum_ctx ctx = { .fp = fp, .bpb = bpb, .fat = fat, .list = &list, .sha256 = sha256 };
+	atomic_init(&ctx.next, 0);
+
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t threads = opts->threads > 0 ? (size_t) opts->threads : (size_t) (cpus > 0 ? cpus : 1);
+	threads = MIN(MIN(threads, list.count), HASHSUM_MAX_THREADS);
+
+	pthread_t tids[HASHSUM_MAX_THREADS];
+	size_t started = 0;
+	for (; started < threads; started++)
+		if (pthread_create(&tids[started], NULL, hashsum_worker, &ctx) != 0)
+			break;
+	if (started == 0)
+		hashsum_worker(&ctx);
+	for (size_t t = 0; t < started; t++)
+		pthread_join(tids[t], NULL);
+
+	for (size_t i = 0; i < list.count; i++)
+		if (list.files[i].truncated)
+			error(0, 0, "aviso: a cadeia de %s termina antes do tamanho do arquivo", list.files[i].path);
+
+	// SAÍDA: UMA LINHA POR ARQUIVO, CAMPOS SEPARADOS POR TAB
+	if (!opts->dups)
+	{
+		qsort(list.files, list.count, sizeof(struct hashsum_file), hashsum_by_path);
+		for (size_t i = 0; i < list.count; i++)
+			hashsum_print(&list.files[i], sha256);
+	}
+	else
+	{
+		// Só os arquivos não vazios com ao menos um igual, agrupados pelo hash
+		qsort(list.files, list.count, sizeof(struct hashsum_file), hashsum_by_content);
+		for (size_t i = 0; i < list.count; i++)
+		{
+			struct hashsum_file *f = &list.files[i];
+			bool dup = (i > 0 && hashsum_same(f, f - 1)) || (i + 1 < list.count && hashsum_same(f, f + 1));
+			if (dup && f->size > 0)
+				hashsum_print(f, sha256);
+		}
+	}
+
+	free(list.files);
+	free(fat);
+}
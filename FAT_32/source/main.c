@@ -6,6 +6,9 @@
 #include "fat16.h"
 #include "commands.h"
 #include "output.h"
+#include "overlay.h"
+#include "container.h"
+#include "delta.h"
 
 /* Show usage help */
 void usage(char *executable)
@@ -15,9 +18,19 @@ void usage(char *executable)
     fprintf(stdout, "\t%s ls <fat32-img> - List files from the FAT32 image\n", executable);
     fprintf(stdout, "\t%s cp <path> <dest> <fat32-img> - Copy files from the image path to local dest.\n", executable);
     fprintf(stdout, "\t%s mv <path> <dest> <fat32-img> - Move files from the path to the FAT32 path\n", executable);
-    fprintf(stdout, "\t%s rm <path> <file> <fat32-img> - Remove files from the path to the FAT32 path\n", executable);
+    fprintf(stdout, "\t%s rm [--punch] <path> <fat32-img> - Remove a file and free its clusters (--punch: also free them on the host)\n", executable);
+    fprintf(stdout, "\t%s cat [--offset N] [--length N] <path> <fat32-img> - Print a file, or a byte range of it\n", executable);
+    fprintf(stdout, "\t%s hashsum [--sha256] [--dups] [--threads N] <fat32-img> - Checksum every file (tab-separated)\n", executable);
+    fprintf(stdout, "\t%s diff [--delta <file>] <other-img> <fat32-img> - List files that differ in other-img, or write a delta to it\n", executable);
+    fprintf(stdout, "\t%s apply <delta> <fat32-img> - Apply a delta written by diff\n", executable);
+    fprintf(stdout, "\t%s sync <source-img> <fat32-img> - Copy only the changed sectors and clusters from source-img\n", executable);
+    fprintf(stdout, "\t%s pack <container> <fat32-img> - Store the image in a compressed container\n", executable);
+    fprintf(stdout, "\t%s unpack <dest> <container> - Extract the raw image from a container\n", executable);
+    fprintf(stdout, "\t%s -o <overlay> <command> ... <fat32-img> - Run a command with writes going to a copy-on-write overlay\n", executable);
+    fprintf(stdout, "\t%s -o <overlay> reset <fat32-img> - Discard the overlay changes\n", executable);
+    fprintf(stdout, "\t%s -o <overlay> commit <fat32-img> - Write the overlay changes into the image\n", executable);
     fprintf(stdout, "\n");
-    fprintf(stdout, "\tfat32-img needs to be a valid FAT32 filesystem.\n\n");
+    fprintf(stdout, "\tfat32-img needs to be a valid FAT32 (or FAT12/FAT16) filesystem, raw or in a container.\n\n");
 }
 int main(int argc, char **argv)
 {
@@ -26,6 +39,16 @@ int main(int argc, char **argv)
 
 	setlocale(LC_ALL, getenv("LANG"));
 
+	// -o <overlay>: a imagem fica somente leitura e as escritas vão para o overlay
+	char *overlay = NULL;
+	if (argc > 2 && strcmp(argv[1], "-o") == 0)
+	{
+		overlay = argv[2];
+		argv[2] = argv[0];
+		argv += 2;
+		argc -= 2;
+	}
+
 	// Args <= 1: Invalid argument count
 	if (argc <= 1)
 		usage(argv[0]),
@@ -39,8 +62,45 @@ int main(int argc, char **argv)
 	// Args > 3: Operations with FAT16 image
 	else if (argc >= 3 || argc >= 4)
 	{
-		// File opened in binary format for read/write (rb+)
-		FILE *fp = fopen(argv[argc - 1], "rb+");
+		// Overlay commands work on the files themselves, not on the filesystem
+		if (strcmp(argv[1], "reset") == 0 || strcmp(argv[1], "commit") == 0)
+		{
+			if (!overlay)
+				usage(argv[0]),
+				exit(EXIT_FAILURE);
+
+			if (strcmp(argv[1], "reset") == 0)
+				overlay_reset(overlay);
+			else
+				overlay_commit(argv[argc - 1], overlay);
+
+			return EXIT_SUCCESS;
+		}
+
+		// Container commands convert between raw images and containers
+		if (strcmp(argv[1], "pack") == 0 || strcmp(argv[1], "unpack") == 0)
+		{
+			if (argc != 4)
+				usage(argv[0]),
+				exit(EXIT_FAILURE);
+
+			if (strcmp(argv[1], "pack") == 0)
+				container_pack(argv[3], argv[2]);
+			else
+				container_unpack(argv[3], argv[2]);
+
+			return EXIT_SUCCESS;
+		}
+
+		// File opened in binary format for read/write (rb+), through the overlay,
+		// or decompressed on demand when the image is a container
+		FILE *fp;
+		if (overlay)
+			fp = overlay_open(argv[argc - 1], overlay);
+		else if (container_detect(argv[argc - 1]))
+			fp = container_open(argv[argc - 1]);
+		else
+			fp = fopen(argv[argc - 1], "rb+");
 
 		if (!fp)
 		{
@@ -53,7 +113,9 @@ int main(int argc, char **argv)
 		rfat(fp, &bpb);
 		char *command = argv[1];
 
-		verbose(&bpb);
+		// cat, hashsum and diff output is meant for pipes and scripts: keep it free of the BPB dump
+		if (strcmp(command, "cat") != 0 && strcmp(command, "hashsum") != 0 && strcmp(command, "diff") != 0)
+			verbose(&bpb);
 
 		////////////////////////
 		/// Commands ///
@@ -82,14 +144,99 @@ int main(int argc, char **argv)
 		// Remove
 		if (strcmp(command, "rm") == 0)
 		{
-			rm(fp, argv[2], &bpb);
+			bool punch = argc > 4 && strcmp(argv[2], "--punch") == 0;
+
+			if (argc != (punch ? 5 : 4))
+				usage(argv[0]),
+				exit(EXIT_FAILURE);
+
+			rm(fp, argv[punch ? 3 : 2], &bpb, punch);
+			fclose(fp);
+		}
+
+		// Hash sum
+		if (strcmp(command, "hashsum") == 0)
+		{
+			struct hashsum_opts opts = { .sha256 = false, .dups = false, .threads = 0 };
+
+			for (int i = 2; i < argc - 1; i++)
+			{
+				if (strcmp(argv[i], "--sha256") == 0)
+					opts.sha256 = true;
+				else if (strcmp(argv[i], "--dups") == 0)
+					opts.dups = true;
+				else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc - 1)
+					opts.threads = atoi(argv[++i]);
+				else
+					usage(argv[0]),
+					exit(EXIT_FAILURE);
+			}
+
+			hashsum(fp, &bpb, &opts);
+			fclose(fp);
+		}
+
+		// Image diff, delta and sync
+		if (strcmp(command, "diff") == 0)
+		{
+			char *other = NULL, *delta = NULL;
+
+			for (int i = 2; i < argc - 1; i++)
+			{
+				if (strcmp(argv[i], "--delta") == 0 && i + 1 < argc - 1)
+					delta = argv[++i];
+				else if (!other)
+					other = argv[i];
+				else
+					usage(argv[0]),
+					exit(EXIT_FAILURE);
+			}
+
+			if (!other)
+				usage(argv[0]),
+				exit(EXIT_FAILURE);
+
+			image_diff(fp, &bpb, other, delta);
+			fclose(fp);
+		}
+
+		if (strcmp(command, "apply") == 0 || strcmp(command, "sync") == 0)
+		{
+			if (argc != 4)
+				usage(argv[0]),
+				exit(EXIT_FAILURE);
+
+			if (strcmp(command, "apply") == 0)
+				image_apply(fp, &bpb, argv[2]);
+			else
+				image_sync(fp, &bpb, argv[2]);
 			fclose(fp);
 		}
 
 		// Cat (Concatenate)
 		if (strcmp(command, "cat") == 0)
 		{
-			cat(fp, argv[2], &bpb);
+			char *filename = NULL;
+			uint64_t offset = 0, length = CAT_TO_END;
+
+			for (int i = 2; i < argc - 1; i++)
+			{
+				if (strcmp(argv[i], "--offset") == 0 && i + 1 < argc - 1)
+					offset = strtoull(argv[++i], NULL, 0);
+				else if (strcmp(argv[i], "--length") == 0 && i + 1 < argc - 1)
+					length = strtoull(argv[++i], NULL, 0);
+				else if (!filename)
+					filename = argv[i];
+				else
+					usage(argv[0]),
+					exit(EXIT_FAILURE);
+			}
+
+			if (!filename)
+				usage(argv[0]),
+				exit(EXIT_FAILURE);
+
+			cat(fp, filename, &bpb, offset, length);
 			fclose(fp);
 		}
 	}
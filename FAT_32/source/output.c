@@ -1,4 +1,5 @@
 #include "output.h"
+#include "fat_engine.h"
 
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
 
@@ -89,6 +90,7 @@ void verbose(struct fat_bpb *bios_pb)
     fprintf(stdout, "Setor com informações do sistema de arquivos: %d\n", bios_pb->fs_info);
     fprintf(stdout, "Setor de backup do boot: %d\n", bios_pb->backup_boot_sector);
 
+    fprintf(stdout, "Variante: FAT%u\n", bios_pb->geo.engine->bits);
     fprintf(stdout, "Endereço da FAT: 0x%x\n", bpb_faddress(bios_pb));
     fprintf(stdout, "Endereço do diretório raiz: 0x%x\n", bpb_froot_addr(bios_pb));
     fprintf(stdout, "Endereço da área de dados: 0x%x\n", bpb_fdata_addr(bios_pb));
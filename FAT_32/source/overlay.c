@@ -0,0 +1,338 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <error.h>
+
+#include "overlay.h"
+#include "commands.h"
+#include "support.h"
+
+#define OVERLAY_MAGIC "OB32OVL1"
+#define OVERLAY_ALIGN 4096
+
+struct overlay_header
+{
+	char     magic[8];
+	uint32_t block_size;
+	uint32_t reserved;
+	uint64_t base_size;   // tamanho da imagem base quando o overlay foi criado
+	uint64_t block_count;
+	uint64_t data_offset; // onde começa o bloco 0
+};
+
+struct overlay
+{
+	int      base_fd;
+	int      ovl_fd;
+	struct overlay_header hdr;
+	uint8_t *bitmap;
+	off64_t  pos;
+};
+
+static bool overlay_has(struct overlay *ov, uint64_t block)
+{
+	return (ov->bitmap[block / 8] >> (block % 8)) & 1;
+}
+
+/*
+ * Primeiro bloco alterado a partir de `block` (block_count se não houver).
+ * Palavras e bytes zerados do bitmap são pulados inteiros: o custo acompanha
+ * as alterações, e não o tamanho da imagem. Os bits depois de block_count
+ * são sempre zero.
+ */
+static uint64_t overlay_next(struct overlay *ov, uint64_t block)
+{
+	const uint64_t count = ov->hdr.block_count;
+
+	while (block < count)
+	{
+		uint64_t word = 1;
+		if (block % 64 == 0 && block + 64 <= count)
+			memcpy(&word, ov->bitmap + block / 8, sizeof(word));
+
+		if (word == 0)
+			block += 64;
+		else if (block % 8 == 0 && ov->bitmap[block / 8] == 0)
+			block += 8;
+		else if (overlay_has(ov, block))
+			return block;
+		else
+			block++;
+	}
+	return count;
+}
+
+/* Grava no overlay a parte do bitmap que cobre os blocos [first, last] */
+static void overlay_mark(struct overlay *ov, uint64_t first, uint64_t last)
+{
+	for (uint64_t b = first; b <= last; b++)
+		ov->bitmap[b / 8] |= (uint8_t) (1u << (b % 8));
+
+	full_pwrite(ov->ovl_fd, ov->bitmap + first / 8, last / 8 - first / 8 + 1, sizeof(struct overlay_header) + first / 8);
+}
+
+/*
+ * Abre (ou cria, se estiver vazio) o overlay de uma base já aberta e carrega
+ * o bitmap. Um overlay feito para uma imagem de outro tamanho é recusado.
+ */
+static struct overlay *overlay_load(int base_fd, const char *overlay_path)
+{
+	struct stat st;
+	if (fstat(base_fd, &st) != 0)
+		error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao obter o tamanho da imagem");
+
+	struct overlay *ov = calloc(1, sizeof(struct overlay));
+	if (!ov)
+		error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar o overlay");
+
+	ov->base_fd = base_fd;
+	ov->ovl_fd  = open(overlay_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (ov->ovl_fd < 0)
+		error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao abrir o overlay %s", overlay_path);
+
+	struct stat ost;
+	fstat(ov->ovl_fd, &ost);
+
+	if ((size_t) ost.st_size < sizeof(struct overlay_header))
+	{
+		// OVERLAY NOVO (OU RESETADO): SÓ O CABEÇALHO, O BITMAP É UM BURACO ZERADO
+		memcpy(ov->hdr.magic, OVERLAY_MAGIC, 8);
+		ov->hdr.block_size  = OVERLAY_BLOCK;
+		ov->hdr.base_size   = (uint64_t) st.st_size;
+		ov->hdr.block_count = (ov->hdr.base_size + OVERLAY_BLOCK - 1) / OVERLAY_BLOCK;
+		ov->hdr.data_offset = (sizeof(struct overlay_header) + (ov->hdr.block_count + 7) / 8 + OVERLAY_ALIGN - 1)
+		                      / OVERLAY_ALIGN * OVERLAY_ALIGN;
+
+		if (ftruncate(ov->ovl_fd, 0) != 0)
+			error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao truncar o overlay");
+		full_pwrite(ov->ovl_fd, &ov->hdr, sizeof(struct overlay_header), 0);
+	}
+	else
+	{
+		full_pread(ov->ovl_fd, &ov->hdr, sizeof(struct overlay_header), 0);
+
+		if (memcmp(ov->hdr.magic, OVERLAY_MAGIC, 8) != 0 || ov->hdr.block_size != OVERLAY_BLOCK)
+			error(EXIT_FAILURE, 0, "%s não é um overlay do obese32.", overlay_path);
+		if (ov->hdr.base_size != (uint64_t) st.st_size)
+			error(EXIT_FAILURE, 0, "O overlay %s foi criado para uma imagem de outro tamanho.", overlay_path);
+	}
+
+	size_t bitmap_size = (ov->hdr.block_count + 7) / 8;
+	ov->bitmap = calloc(bitmap_size + 1, 1);
+	if (!ov->bitmap)
+		error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar o bitmap do overlay");
+	full_pread(ov->ovl_fd, ov->bitmap, bitmap_size, sizeof(struct overlay_header));
+
+	return ov;
+}
+
+static void overlay_free(struct overlay *ov)
+{
+	close(ov->ovl_fd);
+	close(ov->base_fd);
+	free(ov->bitmap);
+	free(ov);
+}
+
+///
+/// FUNÇÕES DO COOKIE (fopencookie)
+
+static ssize_t overlay_read(void *cookie, char *buf, size_t size)
+{
+	struct overlay *ov = cookie;
+	uint64_t pos = (uint64_t) ov->pos;
+
+	if (pos >= ov->hdr.base_size)
+		return 0;
+	size = MIN(size, ov->hdr.base_size - pos);
+
+	// LÊ EM TRECHOS: BLOCOS CONSECUTIVOS DA MESMA ORIGEM SAEM NUMA ÚNICA CHAMADA
+	uint64_t end = pos + size;
+	while (pos < end)
+	{
+		uint64_t block = pos / OVERLAY_BLOCK;
+		bool     mine  = overlay_has(ov, block);
+		uint64_t next  = block + 1;
+
+		while (next * OVERLAY_BLOCK < end && overlay_has(ov, next) == mine)
+			next++;
+
+		size_t len = MIN(next * OVERLAY_BLOCK, end) - pos;
+		if (mine)
+			full_pread(ov->ovl_fd, buf, len, ov->hdr.data_offset + pos);
+		else
+			full_pread(ov->base_fd, buf, len, pos);
+
+		buf += len;
+		pos += len;
+	}
+
+	ov->pos += size;
+	return size;
+}
+
+/* Copia um bloco da base para o overlay antes de uma escrita parcial nele */
+static void overlay_copy_up(struct overlay *ov, uint64_t block)
+{
+	if (overlay_has(ov, block))
+		return;
+
+	char data[OVERLAY_BLOCK];
+	uint64_t offset = block * OVERLAY_BLOCK;
+	size_t   len    = MIN(OVERLAY_BLOCK, ov->hdr.base_size - offset);
+
+	full_pread(ov->base_fd, data, len, offset);
+	full_pwrite(ov->ovl_fd, data, len, ov->hdr.data_offset + offset);
+}
+
+static ssize_t overlay_write(void *cookie, const char *buf, size_t size)
+{
+	struct overlay *ov = cookie;
+	uint64_t pos = (uint64_t) ov->pos;
+
+	// A IMAGEM NÃO CRESCE PELO OVERLAY
+	if (pos >= ov->hdr.base_size)
+	{
+		errno = ENOSPC;
+		return 0;
+	}
+	size = MIN(size, ov->hdr.base_size - pos);
+
+	uint64_t end   = pos + size;
+	uint64_t first = pos / OVERLAY_BLOCK;
+	uint64_t last  = (end - 1) / OVERLAY_BLOCK;
+
+	// SÓ OS BLOCOS DAS PONTAS PODEM SER COBERTOS PELA METADE
+	if (pos % OVERLAY_BLOCK != 0 || end < (first + 1) * OVERLAY_BLOCK)
+		overlay_copy_up(ov, first);
+	if (last != first && end % OVERLAY_BLOCK != 0 && end != ov->hdr.base_size)
+		overlay_copy_up(ov, last);
+
+	// DADOS PRIMEIRO, BITMAP DEPOIS: UM BIT LIGADO SEMPRE APONTA PARA DADOS VÁLIDOS
+	full_pwrite(ov->ovl_fd, buf, size, ov->hdr.data_offset + pos);
+	overlay_mark(ov, first, last);
+
+	ov->pos += size;
+	return size;
+}
+
+static int overlay_seek(void *cookie, off64_t *offset, int whence)
+{
+	struct overlay *ov = cookie;
+	off64_t base;
+
+	switch (whence)
+	{
+		case SEEK_SET: base = 0; break;
+		case SEEK_CUR: base = ov->pos; break;
+		case SEEK_END: base = (off64_t) ov->hdr.base_size; break;
+		default: errno = EINVAL; return -1;
+	}
+
+	if (base + *offset < 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	ov->pos = *offset = base + *offset;
+	return 0;
+}
+
+static int overlay_close(void *cookie)
+{
+	overlay_free(cookie);
+	return 0;
+}
+
+///
+
+FILE *overlay_open(const char *base_path, const char *overlay_path)
+{
+	int base_fd = open(base_path, O_RDONLY | O_CLOEXEC);
+	if (base_fd < 0)
+		return NULL;
+
+	struct overlay *ov = overlay_load(base_fd, overlay_path);
+
+	cookie_io_functions_t io =
+	{
+		.read  = overlay_read,
+		.write = overlay_write,
+		.seek  = overlay_seek,
+		.close = overlay_close,
+	};
+
+	FILE *fp = fopencookie(ov, "r+", io);
+	if (!fp)
+		overlay_free(ov);
+
+	return fp;
+}
+
+/* Um overlay vazio é recriado do zero na próxima abertura */
+static void overlay_truncate(const char *overlay_path)
+{
+	int fd = open(overlay_path, O_WRONLY | O_CLOEXEC);
+
+	if (fd < 0 && errno == ENOENT)
+		return;
+	if (fd < 0 || ftruncate(fd, 0) != 0)
+		error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao truncar o overlay %s", overlay_path);
+
+	close(fd);
+}
+
+void overlay_reset(const char *overlay_path)
+{
+	overlay_truncate(overlay_path);
+	printf("Overlay %s descartado.\n", overlay_path);
+}
+
+void overlay_commit(const char *base_path, const char *overlay_path)
+{
+	int base_fd = open(base_path, O_RDWR | O_CLOEXEC);
+	if (base_fd < 0)
+		error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao abrir %s para escrita", base_path);
+
+	struct overlay *ov = overlay_load(base_fd, overlay_path);
+
+	// COPIA AS SEQUÊNCIAS DE BLOCOS ALTERADOS, ATÉ 1 MiB POR VEZ
+	const uint64_t chunk = 2048;
+	char *data = malloc(chunk * OVERLAY_BLOCK);
+	if (!data)
+		error_at_line(EXIT_FAILURE, ENOMEM, __FILE__, __LINE__, "Falha ao alocar o buffer de commit");
+
+	uint64_t committed = 0;
+	for (uint64_t block = overlay_next(ov, 0); block < ov->hdr.block_count; block = overlay_next(ov, block))
+	{
+		uint64_t next = block + 1;
+		while (next < ov->hdr.block_count && next - block < chunk && overlay_has(ov, next))
+			next++;
+
+		uint64_t offset = block * OVERLAY_BLOCK;
+		size_t   len    = MIN(next * OVERLAY_BLOCK, ov->hdr.base_size) - offset;
+
+		full_pread(ov->ovl_fd, data, len, ov->hdr.data_offset + offset);
+		full_pwrite(base_fd, data, len, offset);
+
+		committed += next - block;
+		block = next;
+	}
+	free(data);
+
+	if (fsync(base_fd) != 0)
+		error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao sincronizar %s", base_path);
+
+	overlay_free(ov);
+	overlay_truncate(overlay_path);
+	printf("%llu blocos aplicados em %s.\n", (unsigned long long) committed, base_path);
+}
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include "support.h"
 #include <stdio.h>
 #include <string.h>
@@ -6,6 +7,10 @@
 #include <ctype.h>
 
 #include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <error.h>
 #include "fat16.h"
 
 
@@ -45,3 +50,37 @@ bool cstr_to_fat16wnull(char *filename, char output[FAT16STR_SIZE_WNULL])
 
 	return false;
 }
+
+/* pread/pwrite completos; erros de E/S abortam como no resto do programa */
+void full_pread(int fd, void *buf, size_t len, off_t offset)
+{
+	char *p = buf;
+	while (len > 0)
+	{
+		ssize_t n = pread(fd, p, len, offset);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao ler em %lld", (long long) offset);
+		if (n == 0)
+		{
+			memset(p, 0, len); // buraco no fim do arquivo esparso
+			return;
+		}
+		p += n, len -= n, offset += n;
+	}
+}
+
+void full_pwrite(int fd, const void *buf, size_t len, off_t offset)
+{
+	const char *p = buf;
+	while (len > 0)
+	{
+		ssize_t n = pwrite(fd, p, len, offset);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			error_at_line(EXIT_FAILURE, errno, __FILE__, __LINE__, "erro ao escrever em %lld", (long long) offset);
+		p += n, len -= n, offset += n;
+	}
+}
@@ -0,0 +1,508 @@
+// Gerador de carga para o servidor nativo (e para o Server em C#, via socket).
+//
+//   g++ -std=c++17 -O2 -pthread loadgen.cpp -o loadgen
+//   ./loadgen [--transport unix|fifo|shm[,...]] [--pipe stringPipe|numberPipe]
+//             [--clients 1,2,4,...] [--pipeline D] [--rate REQ_S]
+//             [--duration S] [--warmup S] [--dir DIR] [--fifo-slots K]
+//
+// Malha fechada (padrão): cada cliente mantém D requisições em voo e envia a
+// próxima assim que uma resposta chega. Malha aberta (--rate): as requisições
+// saem em horários fixos, independentemente das respostas, e a latência é
+// medida a partir do horário planejado, para que um servidor lento não
+// esconda a própria fila (coordinated omission).
+//
+// Com uma lista de transportes (ex.: --transport unix,fifo,shm) a mesma
+// varredura roda para cada um, contra um servidor iniciado com a mesma lista.
+// No shm cada thread de disparo usa um único canal e distingue os seus
+// clientes pela tag das mensagens. No fifo cada cliente ocupa um dos K slots
+// criados pelo servidor (--fifo-slots, 4 nos dois lados por padrão): pontos
+// da varredura com mais clientes que slots são pulados.
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fcntl.h>
+#include <random>
+#include <sys/epoll.h>
+#include <thread>
+#include <vector>
+
+#include "pipe_protocol.h"
+#include "shm_ring.h"
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+struct LoadConfig
+{
+    std::string transport = "unix";
+    std::string dir = "/tmp";
+    Endpoint endpoint = Endpoint::String;
+    int clients = 1;
+    int pipeline = 1;
+    double rate = 0.0;      // req/s no total; 0 = malha fechada
+    double duration = 2.0;  // segundos medidos
+    double warmup = 0.5;    // segundos descartados antes da medição
+    int fifoSlots = 4;      // slots de FIFO do servidor (o mesmo --fifo-slots dele)
+};
+
+struct LoadResult
+{
+    uint64_t completed = 0;
+    uint64_t errors = 0;
+    double seconds = 0.0;
+    std::vector<uint64_t> latencies; // ns
+};
+
+struct Client
+{
+    int readFd = -1;
+    int writeFd = -1;
+    int id = 0;
+    ShmChannel* shm = nullptr; // canal compartilhado pela thread de disparo
+    uint16_t tag = 0;          // índice do cliente dentro da thread
+    std::string request;
+    std::string input;
+    std::string output;
+    std::deque<Clock::time_point> inFlight;
+    Clock::time_point nextSend;
+};
+
+int64_t Nanoseconds(Clock::duration d)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+bool Connect(const LoadConfig& config, Client& client)
+{
+    if (client.shm)
+        return true;
+    if (config.transport == "fifo")
+    {
+        std::string req = FifoPath(config.dir, config.endpoint, client.id, "req");
+        std::string resp = FifoPath(config.dir, config.endpoint, client.id, "resp");
+        client.writeFd = open(req.c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+        client.readFd = open(resp.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (client.writeFd < 0 || client.readFd < 0)
+            return false;
+
+        // Descarta respostas que sobraram de uma rodada anterior no slot.
+        char buffer[4096];
+        while (read(client.readFd, buffer, sizeof(buffer)) > 0)
+            ;
+        return true;
+    }
+
+    sockaddr_un address;
+    if (!FillSocketAddress(SocketPath(config.dir, config.endpoint), address))
+        return false;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) != 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    client.readFd = client.writeFd = fd;
+    return true;
+}
+
+void Disconnect(Client& client)
+{
+    if (client.writeFd >= 0 && client.writeFd != client.readFd)
+        close(client.writeFd);
+    if (client.readFd >= 0)
+        close(client.readFd);
+    client.readFd = client.writeFd = -1;
+}
+
+void Queue(Client& client, Clock::time_point sent)
+{
+    client.output.append(client.request);
+    client.inFlight.push_back(sent);
+}
+
+bool Flush(Client& client)
+{
+    if (client.shm)
+    {
+        // Uma mensagem por linha e uma única campainha para o lote. O que não
+        // coube (fila cheia ou anel de respostas no limite) fica em `output`
+        // até o próximo Flush, depois de Poll() ter lido respostas.
+        size_t start = 0;
+        while (start < client.output.size())
+        {
+            size_t end = client.output.find('\n', start) + 1;
+            if (!client.shm->TrySend(client.tag, client.output.data() + start, end - start, false))
+                break;
+            start = end;
+        }
+        if (start > 0)
+            client.shm->Notify();
+        client.output.erase(0, start);
+        return true;
+    }
+
+    while (!client.output.empty())
+    {
+        ssize_t n = write(client.writeFd, client.output.data(), client.output.size());
+        if (n > 0)
+        {
+            client.output.erase(0, (size_t)n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        return n < 0 && errno == EAGAIN;
+    }
+    return true;
+}
+
+// Lê respostas e devolve quantas linhas completas chegaram; as latências
+// de respostas dentro da janela [measureStart, measureEnd) vão para `result`.
+// No shm as respostas já foram postas em `input` por Poll().
+int Receive(Client& client, Clock::time_point measureStart, Clock::time_point measureEnd, LoadResult& result)
+{
+    char buffer[64 * 1024];
+    ssize_t n;
+    while (!client.shm && (n = read(client.readFd, buffer, sizeof(buffer))) > 0)
+        client.input.append(buffer, (size_t)n);
+
+    int lines = 0;
+    size_t start = 0;
+    Clock::time_point now = Clock::now();
+    for (;;)
+    {
+        size_t end = client.input.find('\n', start);
+        if (end == std::string::npos)
+            break;
+        if (!client.inFlight.empty())
+        {
+            Clock::time_point sent = client.inFlight.front();
+            client.inFlight.pop_front();
+            if (sent >= measureStart && now < measureEnd)
+            {
+                result.latencies.push_back((uint64_t)Nanoseconds(now - sent));
+                ++result.completed;
+                if (client.input.compare(start, 5, "Erro:") == 0)
+                    ++result.errors;
+            }
+        }
+        start = end + 1;
+        ++lines;
+    }
+    client.input.erase(0, start);
+    return lines;
+}
+
+// Espera respostas por até `timeoutNs` e chama `onData` para cada cliente
+// que tem algo a ler.
+template <typename OnData>
+void Poll(int epollFd, std::vector<Client>& clients, int64_t timeoutNs, OnData onData)
+{
+    ShmChannel* shm = clients.front().shm;
+    if (shm)
+    {
+        if (!shm->WaitResponse(timeoutNs))
+            return;
+        ShmMessage message;
+        while (shm->TryReceive(message))
+        {
+            if (message.tag < clients.size())
+                clients[message.tag].input.append(message.data, message.length);
+        }
+        for (Client& c : clients)
+        {
+            if (!c.input.empty())
+                onData(c);
+        }
+        return;
+    }
+
+    // epoll_pwait2 aceita timeout em ns; com ms a malha aberta atrasaria envios.
+    epoll_event events[256];
+    timespec timeout = { (time_t)(timeoutNs / 1000000000), (long)(timeoutNs % 1000000000) };
+    int n = epoll_pwait2(epollFd, events, 256, &timeout, nullptr);
+    for (int i = 0; i < n; ++i)
+        onData(clients[events[i].data.u32]);
+}
+
+void Drive(const LoadConfig& config, std::vector<Client>& clients, Clock::time_point begin, LoadResult& result)
+{
+    const Clock::time_point measureStart = begin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(config.warmup));
+    const Clock::time_point measureEnd = measureStart + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(config.duration));
+    const bool openLoop = config.rate > 0.0;
+    const auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(config.clients / std::max(config.rate, 1e-9)));
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    std::mt19937 rng(1234);
+    for (size_t i = 0; i < clients.size(); ++i)
+    {
+        if (!clients[i].shm)
+        {
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.u32 = (uint32_t)i;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, clients[i].readFd, &event);
+        }
+
+        if (openLoop)
+            clients[i].nextSend = begin + Clock::duration(rng() % (uint64_t)std::max<int64_t>(1, interval.count()));
+        else
+        {
+            for (int d = 0; d < config.pipeline; ++d)
+                Queue(clients[i], begin);
+            Flush(clients[i]);
+        }
+    }
+
+    for (;;)
+    {
+        Clock::time_point now = Clock::now();
+        if (now >= measureEnd)
+            break;
+
+        int64_t timeoutNs = 10000000;
+        if (openLoop)
+        {
+            Clock::time_point earliest = measureEnd;
+            for (Client& c : clients)
+            {
+                // Todas as requisições atrasadas saem num único write().
+                while (c.nextSend <= now)
+                {
+                    Queue(c, c.nextSend);
+                    c.nextSend += interval;
+                }
+                earliest = std::min(earliest, c.nextSend);
+            }
+            timeoutNs = std::max<int64_t>(0, Nanoseconds(earliest - Clock::now()));
+        }
+        for (Client& c : clients)
+            Flush(c);
+
+        Poll(epollFd, clients, timeoutNs, [&](Client& c) {
+            int lines = Receive(c, measureStart, measureEnd, result);
+            if (!openLoop)
+            {
+                Clock::time_point sent = Clock::now();
+                for (int l = 0; l < lines; ++l)
+                    Queue(c, sent);
+            }
+        });
+    }
+
+    // Espera as respostas pendentes (até 1 s) para não deixar lixo no slot.
+    Clock::time_point drainEnd = Clock::now() + std::chrono::seconds(1);
+    for (;;)
+    {
+        size_t pending = 0;
+        for (Client& c : clients)
+        {
+            Flush(c);
+            pending += c.inFlight.size();
+        }
+        if (pending == 0 || Clock::now() >= drainEnd)
+            break;
+        Poll(epollFd, clients, 10000000, [&](Client& c) { Receive(c, measureEnd, measureEnd, result); });
+    }
+    close(epollFd);
+}
+
+bool RunLoad(const LoadConfig& config, LoadResult& result)
+{
+    // Os clientes são divididos entre algumas threads de disparo.
+    int driverCount = (int)std::min<unsigned>(config.clients, std::max(1u, std::thread::hardware_concurrency() / 2));
+    std::vector<std::vector<Client>> groups(driverCount);
+    std::vector<ShmChannel> channels(config.transport == "shm" ? driverCount : 0);
+    for (int d = 0; d < (int)channels.size(); ++d)
+    {
+        if (!channels[d].Open(config.endpoint))
+        {
+            fprintf(stderr, "Erro ao abrir o segmento %s: %s\n", ShmName(config.endpoint).c_str(), strerror(errno));
+            return false;
+        }
+    }
+
+    for (int i = 0; i < config.clients; ++i)
+    {
+        std::vector<Client>& group = groups[i % driverCount];
+        group.emplace_back();
+        Client& client = group.back();
+        client.id = i;
+        client.tag = (uint16_t)(group.size() - 1);
+        client.shm = channels.empty() ? nullptr : &channels[i % driverCount];
+        client.request = config.endpoint == Endpoint::String
+            ? "Thread-" + std::to_string(i + 1) + " request\n"
+            : std::to_string(1000 + i) + "\n";
+        if (!Connect(config, client))
+        {
+            fprintf(stderr, "Erro ao conectar o cliente %d: %s\n", i, strerror(errno));
+            for (auto& g : groups)
+            {
+                for (Client& c : g)
+                    Disconnect(c);
+            }
+            return false;
+        }
+    }
+
+    std::vector<LoadResult> partial(driverCount);
+    std::vector<std::thread> drivers;
+    Clock::time_point begin = Clock::now();
+    for (int d = 0; d < driverCount; ++d)
+        drivers.emplace_back([&, d] { Drive(config, groups[d], begin, partial[d]); });
+    for (auto& t : drivers)
+        t.join();
+
+    for (int d = 0; d < driverCount; ++d)
+    {
+        result.completed += partial[d].completed;
+        result.errors += partial[d].errors;
+        result.latencies.insert(result.latencies.end(), partial[d].latencies.begin(), partial[d].latencies.end());
+        for (Client& c : groups[d])
+            Disconnect(c);
+    }
+    result.seconds = config.duration;
+    return true;
+}
+
+double Percentile(const std::vector<uint64_t>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+    size_t index = std::min(sorted.size() - 1, (size_t)(p * (double)sorted.size()));
+    return (double)sorted[index];
+}
+
+std::vector<int> ParseList(const char* text)
+{
+    std::vector<int> values;
+    for (const char* p = text; *p;)
+    {
+        char* end;
+        long v = strtol(p, &end, 10);
+        if (end == p)
+            break;
+        if (v > 0)
+            values.push_back((int)v);
+        p = *end == ',' ? end + 1 : end;
+    }
+    return values;
+}
+
+std::vector<std::string> ParseNames(const char* text)
+{
+    std::vector<std::string> names;
+    for (const char* p = text; *p;)
+    {
+        size_t length = strcspn(p, ",");
+        if (length > 0)
+            names.emplace_back(p, length);
+        p += length;
+        if (*p == ',')
+            ++p;
+    }
+    return names;
+}
+
+void Usage(const char* executable)
+{
+    fprintf(stderr, "Uso: %s [--transport unix|fifo|shm[,...]] [--pipe stringPipe|numberPipe] [--clients 1,2,4,...]\n"
+                    "          [--pipeline D] [--rate REQ_S] [--duration S] [--warmup S] [--dir DIR] [--fifo-slots K]\n", executable);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    LoadConfig config;
+    std::vector<int> clientCounts = { 1, 2, 4, 8, 16, 32, 64 };
+    std::vector<std::string> transports;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--transport") == 0 && i + 1 < argc)
+            transports = ParseNames(argv[++i]);
+        else if (strcmp(argv[i], "--pipe") == 0 && i + 1 < argc && ParseEndpoint(argv[i + 1], config.endpoint))
+            ++i;
+        else if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc)
+            clientCounts = ParseList(argv[++i]);
+        else if (strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc)
+            config.pipeline = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+            config.rate = atof(argv[++i]);
+        else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc)
+            config.duration = atof(argv[++i]);
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+            config.warmup = atof(argv[++i]);
+        else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+            config.dir = argv[++i];
+        else if (strcmp(argv[i], "--fifo-slots") == 0 && i + 1 < argc)
+            config.fifoSlots = std::max(1, atoi(argv[++i]));
+        else
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (transports.empty())
+        transports.push_back(config.transport);
+    for (const std::string& t : transports)
+    {
+        if (t != "unix" && t != "fifo" && t != "shm")
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (clientCounts.empty() || config.duration <= 0
+        || (std::find(transports.begin(), transports.end(), "shm") != transports.end()
+            && *std::max_element(clientCounts.begin(), clientCounts.end()) > SHM_CAPACITY / config.pipeline))
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    // Uma falha de conexão encerra a varredura do transporte, não as seguintes.
+    int status = 0;
+    for (size_t t = 0; t < transports.size(); ++t)
+    {
+        config.transport = transports[t];
+        if (t > 0)
+            printf("\n");
+        printf("%s via %s, %s", EndpointName(config.endpoint), config.transport.c_str(), config.rate > 0 ? "malha aberta" : "malha fechada");
+        if (config.rate > 0)
+            printf(" a %.0f req/s\n", config.rate);
+        else
+            printf(", pipeline %d\n", config.pipeline);
+        printf("%8s %12s %10s %10s %10s %8s\n", "clientes", "req/s", "p50 (us)", "p99 (us)", "p999 (us)", "erros");
+
+        for (int clients : clientCounts)
+        {
+            config.clients = clients;
+            if (config.transport == "fifo" && clients > config.fifoSlots)
+            {
+                printf("%8d   pulado: o servidor tem %d slots de FIFO (--fifo-slots)\n", clients, config.fifoSlots);
+                continue;
+            }
+
+            LoadResult result;
+            if (!RunLoad(config, result))
+            {
+                status = 1;
+                break;
+            }
+
+            std::sort(result.latencies.begin(), result.latencies.end());
+            printf("%8d %12.0f %10.1f %10.1f %10.1f %8llu\n", clients, result.completed / result.seconds,
+                Percentile(result.latencies, 0.50) * 1e-3, Percentile(result.latencies, 0.99) * 1e-3,
+                Percentile(result.latencies, 0.999) * 1e-3, (unsigned long long)result.errors);
+            fflush(stdout);
+        }
+    }
+    return status;
+}
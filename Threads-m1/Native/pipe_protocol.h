@@ -0,0 +1,117 @@
+#pragma once
+
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Protocolo de linha do Threads-m1: o cliente envia uma linha terminada em
+// '\n' e recebe uma linha de resposta, na mesma ordem. Este cabeçalho é
+// compartilhado pelo servidor e pelo gerador de carga nativos.
+
+enum class Endpoint
+{
+    String, // stringPipe: devolve a linha em maiúsculas
+    Number, // numberPipe: devolve o quadrado do número
+};
+
+inline const char* EndpointName(Endpoint endpoint)
+{
+    return endpoint == Endpoint::String ? "stringPipe" : "numberPipe";
+}
+
+inline bool ParseEndpoint(const char* name, Endpoint& endpoint)
+{
+    if (strcmp(name, "stringPipe") == 0)
+        endpoint = Endpoint::String;
+    else if (strcmp(name, "numberPipe") == 0)
+        endpoint = Endpoint::Number;
+    else
+        return false;
+    return true;
+}
+
+// Equivalente ao int.TryParse do C#: espaços nas pontas, sinal opcional, int32.
+inline bool TryParseInt(const char* text, size_t len, int32_t& value)
+{
+    while (len > 0 && isspace((unsigned char)*text))
+        ++text, --len;
+    while (len > 0 && isspace((unsigned char)text[len - 1]))
+        --len;
+    if (len == 0 || len > 16)
+        return false;
+
+    char digits[17];
+    memcpy(digits, text, len);
+    digits[len] = '\0';
+
+    char* end;
+    errno = 0;
+    long long parsed = strtoll(digits, &end, 10);
+    if (errno != 0 || *end != '\0' || parsed < INT32_MIN || parsed > INT32_MAX)
+        return false;
+    value = (int32_t)parsed;
+    return true;
+}
+
+// Acrescenta a `out` a resposta (com '\n') para uma linha de requisição sem o
+// terminador. As mensagens são as mesmas do Server/Program.cs.
+inline void HandleRequest(Endpoint endpoint, const char* line, size_t len, std::string& out)
+{
+    if (len > 0 && line[len - 1] == '\r')
+        --len;
+
+    int32_t number;
+    if (endpoint == Endpoint::String)
+    {
+        out.append("Resposta de string: ");
+        size_t start = out.size();
+        out.append(line, len);
+        for (size_t i = start; i < out.size(); ++i)
+            out[i] = (char)toupper((unsigned char)out[i]);
+    }
+    else if (TryParseInt(line, len, number))
+    {
+        // number * number em C# é int32 sem checagem: o estouro dá a volta.
+        int32_t square = (int32_t)((uint32_t)number * (uint32_t)number);
+        char buffer[48];
+        int n = snprintf(buffer, sizeof(buffer), "Número ao quadrado: %d", square);
+        out.append(buffer, (size_t)n);
+    }
+    else
+    {
+        out.append("Erro: entrada inválida");
+    }
+    out.push_back('\n');
+}
+
+// No Linux o NamedPipeServerStream do .NET é um socket UNIX em
+// /tmp/CoreFxPipe_<nome>; usar o mesmo caminho deixa o Client em C# falar
+// com o servidor nativo sem mudanças.
+inline std::string SocketPath(const std::string& dir, Endpoint endpoint)
+{
+    return dir + "/CoreFxPipe_" + EndpointName(endpoint);
+}
+
+// FIFOs não têm conexões: cada "slot" é um par requisição/resposta fixo.
+inline std::string FifoPath(const std::string& dir, Endpoint endpoint, int slot, const char* direction)
+{
+    return dir + "/" + EndpointName(endpoint) + "." + std::to_string(slot) + "." + direction;
+}
+
+inline bool FillSocketAddress(const std::string& path, sockaddr_un& address)
+{
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+        return false;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
@@ -0,0 +1,554 @@
+// Servidor nativo do protocolo stringPipe/numberPipe.
+//
+//   g++ -std=c++17 -O2 -pthread server.cpp -o server
+//   ./server [--transport unix|fifo|shm[,...]] [--workers N] [--dir DIR] [--fifo-slots K]
+//
+// Em vez de uma thread bloqueada por conexão (Server/Program.cs), um conjunto
+// fixo de workers roda cada um o seu epoll. Os sockets de escuta entram em
+// todos os epolls com EPOLLEXCLUSIVE, então cada conexão nova acorda um único
+// worker e fica com ele. Requisições em pipeline são respondidas em lote: tudo
+// que chegou num read() vira uma única chamada a write().
+//
+// Com --transport shm cada worker consome uma fila MPSC em memória
+// compartilhada (shm_ring.h) e responde nos anéis dos clientes, acordando
+// cada anel uma vez por lote. Vários transportes podem rodar juntos
+// (ex.: --transport unix,fifo,shm) para o loadgen compará-los.
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "pipe_protocol.h"
+#include "shm_ring.h"
+
+namespace
+{
+
+struct Connection
+{
+    int readFd;
+    int writeFd;      // igual a readFd para sockets
+    Endpoint endpoint;
+    bool persistent;  // slots de FIFO nunca são fechados
+    std::string input;
+    std::string output;
+    size_t written = 0;
+    bool wantsWrite = false;
+    bool closing = false; // cliente fechou; só falta entregar a saída
+};
+
+struct Listener
+{
+    int fd;
+    Endpoint endpoint;
+};
+
+std::atomic<bool> running{ true };
+
+class Worker
+{
+public:
+    explicit Worker(const std::vector<Listener>& listeners)
+        : listeners(listeners)
+    {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        for (const Listener& l : listeners)
+        {
+            epoll_event event = {};
+            event.events = EPOLLIN | EPOLLEXCLUSIVE;
+            event.data.fd = l.fd;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, l.fd, &event);
+        }
+    }
+
+    ~Worker()
+    {
+        for (auto& c : connections)
+        {
+            if (!c.second.persistent)
+                close(c.first);
+        }
+        close(epollFd);
+    }
+
+    // Registra um slot de FIFO já aberto; usado no lugar de accept().
+    void AddFifo(int readFd, int writeFd, Endpoint endpoint)
+    {
+        Connection& c = connections[readFd];
+        c.readFd = readFd;
+        c.writeFd = writeFd;
+        c.endpoint = endpoint;
+        c.persistent = true;
+        Watch(readFd, EPOLLIN, EPOLL_CTL_ADD);
+    }
+
+    void Run()
+    {
+        epoll_event events[256];
+        while (running.load(std::memory_order_relaxed))
+        {
+            int n = epoll_wait(epollFd, events, 256, 200);
+            for (int i = 0; i < n; ++i)
+            {
+                int fd = events[i].data.fd;
+                const Listener* listener = FindListener(fd);
+                if (listener)
+                {
+                    Accept(*listener);
+                    continue;
+                }
+
+                auto owner = fifoWriters.find(fd);
+                if (owner != fifoWriters.end())
+                    fd = owner->second;
+
+                auto it = connections.find(fd);
+                if (it == connections.end())
+                    continue;
+                Connection& c = it->second;
+
+                bool alive = true;
+                if (!c.closing && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+                    alive = OnReadable(c);
+                if (alive && (events[i].events & EPOLLOUT))
+                    alive = Flush(c);
+                if (!alive)
+                    Close(fd);
+            }
+        }
+    }
+
+private:
+    const std::vector<Listener>& listeners;
+    std::unordered_map<int, Connection> connections;
+    std::unordered_map<int, int> fifoWriters; // fd de resposta -> fd de requisição
+    int epollFd;
+
+    const Listener* FindListener(int fd) const
+    {
+        for (const Listener& l : listeners)
+        {
+            if (l.fd == fd)
+                return &l;
+        }
+        return nullptr;
+    }
+
+    void Watch(int fd, uint32_t events, int op)
+    {
+        epoll_event event = {};
+        event.events = events;
+        event.data.fd = fd;
+        epoll_ctl(epollFd, op, fd, &event);
+    }
+
+    void Accept(const Listener& listener)
+    {
+        for (;;)
+        {
+            int fd = accept4(listener.fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+                return; // EAGAIN: outro worker levou a conexão, ou acabou a fila
+
+            Connection& c = connections[fd];
+            c.readFd = c.writeFd = fd;
+            c.endpoint = listener.endpoint;
+            c.persistent = false;
+            Watch(fd, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_ADD);
+        }
+    }
+
+    // Lê o que houver, responde todas as linhas completas e tenta escrever
+    // tudo de uma vez. Retorna false quando a conexão deve ser fechada.
+    bool OnReadable(Connection& c)
+    {
+        char buffer[64 * 1024];
+        bool eof = false;
+        for (;;)
+        {
+            ssize_t n = read(c.readFd, buffer, sizeof(buffer));
+            if (n > 0)
+            {
+                c.input.append(buffer, (size_t)n);
+                if ((size_t)n < sizeof(buffer))
+                    break;
+                continue;
+            }
+            if (n == 0)
+                eof = true;
+            else if (errno == EINTR)
+                continue;
+            else if (errno != EAGAIN)
+                eof = true;
+            break;
+        }
+
+        size_t start = 0;
+        for (;;)
+        {
+            const char* newline = (const char*)memchr(c.input.data() + start, '\n', c.input.size() - start);
+            if (!newline)
+                break;
+            size_t end = (size_t)(newline - c.input.data());
+            HandleRequest(c.endpoint, c.input.data() + start, end - start, c.output);
+            start = end + 1;
+        }
+        c.input.erase(0, start);
+
+        if (!Flush(c))
+            return false;
+        if (!eof || c.persistent)
+            return true;
+        if (!c.wantsWrite)
+            return false;
+
+        // Meio-fechamento: para de ler e fecha depois de entregar as respostas.
+        c.closing = true;
+        Watch(c.writeFd, EPOLLOUT, EPOLL_CTL_MOD);
+        return true;
+    }
+
+    bool Flush(Connection& c)
+    {
+        while (c.written < c.output.size())
+        {
+            ssize_t n = write(c.writeFd, c.output.data() + c.written, c.output.size() - c.written);
+            if (n > 0)
+            {
+                c.written += (size_t)n;
+                continue;
+            }
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && errno == EAGAIN)
+            {
+                if (!c.wantsWrite)
+                {
+                    c.wantsWrite = true;
+                    if (c.persistent)
+                    {
+                        fifoWriters[c.writeFd] = c.readFd;
+                        Watch(c.writeFd, EPOLLOUT, EPOLL_CTL_ADD);
+                    }
+                    else
+                    {
+                        Watch(c.readFd, EPOLLIN | EPOLLOUT | EPOLLRDHUP, EPOLL_CTL_MOD);
+                    }
+                }
+                return true;
+            }
+            return false;
+        }
+
+        c.output.clear();
+        c.written = 0;
+        if (c.closing)
+            return false;
+        if (c.wantsWrite)
+        {
+            c.wantsWrite = false;
+            if (c.persistent)
+            {
+                fifoWriters.erase(c.writeFd);
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, c.writeFd, nullptr);
+            }
+            else
+            {
+                Watch(c.readFd, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_MOD);
+            }
+        }
+        return true;
+    }
+
+    void Close(int fd)
+    {
+        auto it = connections.find(fd);
+        if (it == connections.end() || it->second.persistent)
+            return;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        connections.erase(it);
+    }
+};
+
+// Consome uma fila de requisições do segmento; é o único produtor dos anéis
+// de resposta dos clientes dessa fila.
+class ShmWorker
+{
+public:
+    ShmWorker(ShmSegment* segment, uint32_t queue, Endpoint endpoint)
+        : segment(segment), queue(segment->requests[queue]), endpoint(endpoint)
+    {
+    }
+
+    void Run()
+    {
+        std::vector<uint16_t> touched;
+        std::string response;
+        ShmMessage request, reply;
+        while (running.load(std::memory_order_relaxed))
+        {
+            // Acorda a cada 200 ms para notar o pedido de encerramento; com
+            // respostas retidas, a cada 100 us para tentar entregá-las.
+            touched.clear();
+            bool ready = waiter.Wait(queue.bell, [this] { return !queue.Empty(); }, backlogged.empty() ? 200000000 : 100000);
+            FlushBacklog(touched);
+
+            while (ready && queue.TryPop(request))
+            {
+                size_t length = request.length;
+                if (length > 0 && request.data[length - 1] == '\n')
+                    --length;
+                response.clear();
+                HandleRequest(endpoint, request.data, length, response);
+
+                reply.slot = request.slot;
+                reply.tag = request.tag;
+                reply.length = (uint32_t)std::min<size_t>(response.size(), SHM_PAYLOAD);
+                memcpy(reply.data, response.data(), reply.length);
+                if (Deliver(reply))
+                    Touch(touched, reply.slot);
+            }
+            for (uint16_t slot : touched)
+                segment->responses[slot].bell.Ring();
+        }
+    }
+
+private:
+    ShmSegment* segment;
+    MpscQueue& queue;
+    Endpoint endpoint;
+    AdaptiveWaiter waiter;
+    std::deque<ShmMessage> backlog[SHM_MAX_CLIENTS]; // respostas que não couberam no anel
+    std::vector<uint16_t> backlogged;                // slots com backlog não vazio
+
+    static void Touch(std::vector<uint16_t>& touched, uint16_t slot)
+    {
+        if (std::find(touched.begin(), touched.end(), slot) == touched.end())
+            touched.push_back(slot);
+    }
+
+    // Nunca espera: com o anel cheio a resposta vai para o backlog do slot,
+    // para um cliente lento não segurar os outros clientes desta fila.
+    bool Deliver(const ShmMessage& reply)
+    {
+        std::deque<ShmMessage>& pending = backlog[reply.slot];
+        if (pending.empty() && segment->responses[reply.slot].TryPush(reply))
+            return true;
+        if (pending.empty())
+            backlogged.push_back(reply.slot);
+        pending.push_back(reply);
+        return false;
+    }
+
+    // Entrega o que couber dos backlogs, em ordem; descarta o de quem saiu.
+    void FlushBacklog(std::vector<uint16_t>& touched)
+    {
+        for (size_t i = 0; i < backlogged.size();)
+        {
+            uint16_t slot = backlogged[i];
+            std::deque<ShmMessage>& pending = backlog[slot];
+            if (segment->claimed[slot].load() == 0)
+                pending.clear();
+            SpscRing& ring = segment->responses[slot];
+            while (!pending.empty() && ring.TryPush(pending.front()))
+            {
+                pending.pop_front();
+                Touch(touched, slot);
+            }
+            if (pending.empty())
+            {
+                backlogged[i] = backlogged.back();
+                backlogged.pop_back();
+            }
+            else
+            {
+                // Ainda cheio: garante que o cliente acorde para esvaziar o anel.
+                Touch(touched, slot);
+                ++i;
+            }
+        }
+    }
+};
+
+int Listen(const std::string& path)
+{
+    sockaddr_un address;
+    if (!FillSocketAddress(path, address))
+        return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    unlink(path.c_str());
+    if (bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void Usage(const char* executable)
+{
+    fprintf(stderr, "Uso: %s [--transport unix|fifo|shm[,...]] [--workers N] [--dir DIR] [--fifo-slots K]\n", executable);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::string transport = "unix";
+    std::string dir = "/tmp";
+    int workerCount = (int)std::min(4u, std::max(1u, std::thread::hardware_concurrency()));
+    int fifoSlots = 4;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--transport") == 0 && i + 1 < argc)
+            transport = argv[++i];
+        else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+            workerCount = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+            dir = argv[++i];
+        else if (strcmp(argv[i], "--fifo-slots") == 0 && i + 1 < argc)
+            fifoSlots = std::max(1, atoi(argv[++i]));
+        else
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    bool useUnix = false, useFifo = false, useShm = false;
+    for (size_t start = 0; start <= transport.size();)
+    {
+        size_t end = std::min(transport.find(',', start), transport.size());
+        std::string name = transport.substr(start, end - start);
+        if (name == "unix")
+            useUnix = true;
+        else if (name == "fifo")
+            useFifo = true;
+        else if (name == "shm")
+            useShm = true;
+        else
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+        start = end + 1;
+    }
+
+    // Encerramento por SIGINT/SIGTERM, tratado na thread principal.
+    signal(SIGPIPE, SIG_IGN);
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+
+    const Endpoint endpoints[] = { Endpoint::String, Endpoint::Number };
+    std::vector<Listener> listeners;
+    std::vector<std::string> cleanup;
+    if (useUnix)
+    {
+        for (Endpoint endpoint : endpoints)
+        {
+            std::string path = SocketPath(dir, endpoint);
+            int fd = Listen(path);
+            if (fd < 0)
+            {
+                fprintf(stderr, "Erro ao escutar em %s: %s\n", path.c_str(), strerror(errno));
+                return 1;
+            }
+            listeners.push_back({ fd, endpoint });
+            cleanup.push_back(path);
+        }
+    }
+
+    std::vector<Worker*> workers;
+    for (int i = 0; i < workerCount; ++i)
+        workers.push_back(new Worker(listeners));
+
+    if (useFifo)
+    {
+        // Os dois lados são abertos O_RDWR para o servidor nunca ver EOF nem
+        // ENXIO quando um cliente entra ou sai do slot.
+        int next = 0;
+        for (Endpoint endpoint : endpoints)
+        {
+            for (int slot = 0; slot < fifoSlots; ++slot)
+            {
+                std::string req = FifoPath(dir, endpoint, slot, "req");
+                std::string resp = FifoPath(dir, endpoint, slot, "resp");
+                unlink(req.c_str());
+                unlink(resp.c_str());
+                if (mkfifo(req.c_str(), 0666) != 0 || mkfifo(resp.c_str(), 0666) != 0)
+                {
+                    fprintf(stderr, "Erro ao criar FIFO %s: %s\n", req.c_str(), strerror(errno));
+                    return 1;
+                }
+                int readFd = open(req.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+                int writeFd = open(resp.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+                workers[next++ % workerCount]->AddFifo(readFd, writeFd, endpoint);
+                cleanup.push_back(req);
+                cleanup.push_back(resp);
+            }
+        }
+    }
+
+    std::vector<std::pair<Endpoint, ShmSegment*>> segments;
+    std::vector<ShmWorker*> shmWorkers;
+    if (useShm)
+    {
+        for (Endpoint endpoint : endpoints)
+        {
+            ShmSegment* segment = CreateShmSegment(endpoint, (uint32_t)workerCount);
+            if (!segment)
+            {
+                fprintf(stderr, "Erro ao criar o segmento %s: %s\n", ShmName(endpoint).c_str(), strerror(errno));
+                return 1;
+            }
+            segments.emplace_back(endpoint, segment);
+            for (uint32_t q = 0; q < segment->queueCount; ++q)
+                shmWorkers.push_back(new ShmWorker(segment, q, endpoint));
+        }
+    }
+
+    std::vector<std::thread> threads;
+    if (useUnix || useFifo)
+    {
+        for (Worker* worker : workers)
+            threads.emplace_back([worker] { worker->Run(); });
+    }
+    for (ShmWorker* worker : shmWorkers)
+        threads.emplace_back([worker] { worker->Run(); });
+
+    printf("Servidor iniciado (%s, %d workers)...\n", transport.c_str(), workerCount);
+    fflush(stdout);
+
+    int received;
+    sigwait(&stopSignals, &received);
+    running.store(false);
+    for (auto& t : threads)
+        t.join();
+    for (Worker* worker : workers)
+        delete worker;
+    for (ShmWorker* worker : shmWorkers)
+        delete worker;
+    for (auto& s : segments)
+        DestroyShmSegment(s.first, s.second);
+    for (const Listener& l : listeners)
+        close(l.fd);
+    for (const std::string& path : cleanup)
+        unlink(path.c_str());
+
+    printf("Servidor encerrado.\n");
+    return 0;
+}
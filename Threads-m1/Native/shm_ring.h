@@ -0,0 +1,392 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <linux/futex.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPU_RELAX() _mm_pause()
+#else
+#define CPU_RELAX() std::this_thread::yield()
+#endif
+
+#include "pipe_protocol.h"
+
+// Transporte por memória compartilhada para stringPipe/numberPipe.
+//
+// Cada endpoint tem um segmento POSIX (/dev/shm/threads-m1-<pipe>) com:
+//   - `queueCount` filas MPSC de requisições, uma por worker do servidor;
+//   - um anel SPSC de respostas por cliente conectado.
+// O cliente pega um slot livre, publica requisições na fila slot % queueCount
+// e lê as respostas no seu anel; o worker dono da fila é o único produtor
+// desse anel, então SPSC basta. Quem espera gira um pouco e depois dorme num
+// futex; quem publica só faz a syscall de wake quando há alguém dormindo.
+//
+// Ninguém espera o outro lado dentro de um envio: o cliente nunca tem mais
+// requisições sem resposta do que cabem no seu anel, e o worker guarda numa
+// fila local as respostas que não couberam, em vez de travar por um cliente
+// lento.
+
+#define SHM_MAGIC 0x53484d31u // "SHM1"
+#define SHM_MAX_CLIENTS 128
+#define SHM_MAX_QUEUES 16
+#define SHM_CAPACITY 512      // células por fila/anel, potência de 2
+#define SHM_PAYLOAD 248       // cabe a maior resposta para uma linha de 220 bytes
+#define SHM_MAX_REQUEST 220   // inclui o '\n'
+
+struct ShmMessage
+{
+    uint16_t slot;    // cliente que enviou / vai receber
+    uint16_t tag;     // livre para o cliente (ex.: qual conexão lógica)
+    uint32_t length;
+    char data[SHM_PAYLOAD];
+};
+
+inline long Futex(std::atomic<uint32_t>* word, int op, uint32_t value, const timespec* timeout)
+{
+    // Sem FUTEX_PRIVATE_FLAG: o futex vive em memória compartilhada entre processos.
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), op, value, timeout, nullptr, 0);
+}
+
+// Campainha de uma fila: um contador de sequência onde o consumidor dorme e
+// quantos consumidores estão dormindo nele.
+struct alignas(64) Doorbell
+{
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> waiters;
+
+    void Ring()
+    {
+        sequence.fetch_add(1, std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_seq_cst) != 0)
+            Futex(&sequence, FUTEX_WAKE, INT_MAX, nullptr);
+    }
+};
+
+// Espera girando enquanto isso costuma compensar: o limite de giros dobra
+// quando a condição é satisfeita girando e cai pela metade quando foi preciso
+// dormir, acompanhando a carga atual.
+class AdaptiveWaiter
+{
+public:
+    // Espera `ready()` ficar verdadeiro por até `timeoutNs` (negativo = sem
+    // limite). Retorna false se o tempo acabou.
+    template <typename Ready>
+    bool Wait(Doorbell& bell, Ready ready, int64_t timeoutNs)
+    {
+        // Com uma CPU só, girar apenas atrasa o outro lado.
+        static const bool spinning = std::thread::hardware_concurrency() > 1;
+        for (int i = 0; spinning && i < spinLimit; ++i)
+        {
+            if (ready())
+            {
+                spinLimit = std::min(spinLimit * 2, MaxSpins);
+                return true;
+            }
+            CPU_RELAX();
+        }
+        if (spinning)
+            spinLimit = std::max(spinLimit / 2, MinSpins);
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(timeoutNs);
+        for (;;)
+        {
+            uint32_t sequence = bell.sequence.load(std::memory_order_seq_cst);
+            bell.waiters.fetch_add(1, std::memory_order_seq_cst);
+            if (ready())
+            {
+                bell.waiters.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            timespec relative;
+            timespec* timeout = nullptr;
+            if (timeoutNs >= 0)
+            {
+                int64_t remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now()).count();
+                if (remaining <= 0)
+                {
+                    bell.waiters.fetch_sub(1, std::memory_order_relaxed);
+                    return false;
+                }
+                relative.tv_sec = (time_t)(remaining / 1000000000);
+                relative.tv_nsec = (long)(remaining % 1000000000);
+                timeout = &relative;
+            }
+            Futex(&bell.sequence, FUTEX_WAIT, sequence, timeout);
+            bell.waiters.fetch_sub(1, std::memory_order_relaxed);
+            if (ready())
+                return true;
+        }
+    }
+
+private:
+    static const int MinSpins = 64;
+    static const int MaxSpins = 1 << 14;
+    int spinLimit = 1024;
+};
+
+// Fila limitada de múltiplos produtores e um consumidor (algoritmo de
+// Vyukov): cada célula carrega uma sequência que diz de quem é a vez.
+struct MpscQueue
+{
+    struct Cell
+    {
+        std::atomic<uint64_t> sequence;
+        ShmMessage message;
+    };
+
+    alignas(64) std::atomic<uint64_t> enqueuePos;
+    alignas(64) std::atomic<uint64_t> dequeuePos;
+    Doorbell bell;
+    Cell cells[SHM_CAPACITY];
+
+    void Init()
+    {
+        for (uint64_t i = 0; i < SHM_CAPACITY; ++i)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool TryPush(const ShmMessage& message)
+    {
+        uint64_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;)
+        {
+            cell = &cells[pos & (SHM_CAPACITY - 1)];
+            int64_t diff = (int64_t)cell->sequence.load(std::memory_order_acquire) - (int64_t)pos;
+            if (diff == 0)
+            {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false; // cheia
+            else
+                pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+        memcpy(&cell->message, &message, offsetof(ShmMessage, data) + message.length);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(ShmMessage& message)
+    {
+        uint64_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell& cell = cells[pos & (SHM_CAPACITY - 1)];
+        if ((int64_t)cell.sequence.load(std::memory_order_acquire) - (int64_t)(pos + 1) < 0)
+            return false;
+        memcpy(&message, &cell.message, offsetof(ShmMessage, data) + cell.message.length);
+        cell.sequence.store(pos + SHM_CAPACITY, std::memory_order_release);
+        dequeuePos.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool Empty() const
+    {
+        uint64_t pos = dequeuePos.load(std::memory_order_relaxed);
+        return (int64_t)cells[pos & (SHM_CAPACITY - 1)].sequence.load(std::memory_order_acquire) - (int64_t)(pos + 1) < 0;
+    }
+};
+
+// Anel de um produtor e um consumidor; cabeça e cauda em linhas separadas.
+struct SpscRing
+{
+    alignas(64) std::atomic<uint64_t> head; // só o consumidor escreve
+    alignas(64) std::atomic<uint64_t> tail; // só o produtor escreve
+    Doorbell bell;
+    ShmMessage cells[SHM_CAPACITY];
+
+    bool TryPush(const ShmMessage& message)
+    {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == SHM_CAPACITY)
+            return false;
+        memcpy(&cells[t & (SHM_CAPACITY - 1)], &message, offsetof(ShmMessage, data) + message.length);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(ShmMessage& message)
+    {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        const ShmMessage& cell = cells[h & (SHM_CAPACITY - 1)];
+        memcpy(&message, &cell, offsetof(ShmMessage, data) + cell.length);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Empty() const
+    {
+        return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire);
+    }
+};
+
+struct ShmSegment
+{
+    uint32_t magic;
+    uint32_t queueCount;
+    std::atomic<uint32_t> claimed[SHM_MAX_CLIENTS];
+    MpscQueue requests[SHM_MAX_QUEUES];
+    SpscRing responses[SHM_MAX_CLIENTS];
+};
+
+inline std::string ShmName(Endpoint endpoint)
+{
+    return std::string("/threads-m1-") + EndpointName(endpoint);
+}
+
+// Lado do servidor: recria o segmento do zero. ftruncate entrega páginas
+// zeradas, então só as sequências das filas MPSC precisam ser iniciadas.
+inline ShmSegment* CreateShmSegment(Endpoint endpoint, uint32_t queueCount)
+{
+    std::string name = ShmName(endpoint);
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+    if (fd < 0)
+        return nullptr;
+    if (ftruncate(fd, sizeof(ShmSegment)) != 0)
+    {
+        close(fd);
+        return nullptr;
+    }
+    void* p = mmap(nullptr, sizeof(ShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return nullptr;
+
+    ShmSegment* segment = (ShmSegment*)p;
+    segment->queueCount = std::min<uint32_t>(std::max<uint32_t>(queueCount, 1), SHM_MAX_QUEUES);
+    for (uint32_t q = 0; q < segment->queueCount; ++q)
+        segment->requests[q].Init();
+    std::atomic_thread_fence(std::memory_order_release);
+    segment->magic = SHM_MAGIC;
+    return segment;
+}
+
+inline void DestroyShmSegment(Endpoint endpoint, ShmSegment* segment)
+{
+    munmap(segment, sizeof(ShmSegment));
+    shm_unlink(ShmName(endpoint).c_str());
+}
+
+// Lado do cliente: uma conexão com um slot próprio no segmento.
+class ShmChannel
+{
+public:
+    ShmChannel() = default;
+    ShmChannel(const ShmChannel&) = delete;
+    ShmChannel& operator=(const ShmChannel&) = delete;
+
+    bool Open(Endpoint endpoint)
+    {
+        int fd = shm_open(ShmName(endpoint).c_str(), O_RDWR, 0);
+        if (fd < 0)
+            return false;
+        void* p = mmap(nullptr, sizeof(ShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED)
+            return false;
+        segment = (ShmSegment*)p;
+        if (segment->magic != SHM_MAGIC)
+        {
+            Close();
+            errno = EPROTO;
+            return false;
+        }
+
+        for (uint32_t i = 0; i < SHM_MAX_CLIENTS; ++i)
+        {
+            uint32_t expected = 0;
+            if (segment->claimed[i].compare_exchange_strong(expected, 1))
+            {
+                slot = (int)i;
+                outstanding = 0;
+                // Descarta respostas de um dono anterior do slot.
+                SpscRing& ring = segment->responses[slot];
+                ring.head.store(ring.tail.load(std::memory_order_acquire), std::memory_order_release);
+                return true;
+            }
+        }
+        Close();
+        errno = EBUSY;
+        return false;
+    }
+
+    void Close()
+    {
+        if (segment && slot >= 0)
+            segment->claimed[slot].store(0);
+        if (segment)
+            munmap(segment, sizeof(ShmSegment));
+        segment = nullptr;
+        slot = -1;
+    }
+
+    ~ShmChannel() { Close(); }
+
+    // Publica uma linha (com o '\n'). Não espera: retorna false se a fila
+    // estiver cheia ou se SHM_CAPACITY requisições ainda aguardam resposta
+    // (mais que isso não caberia no anel). Quem chama lê as respostas com
+    // TryReceive() e tenta de novo.
+    bool TrySend(uint16_t tag, const char* line, size_t length, bool ring = true)
+    {
+        if (length > SHM_MAX_REQUEST || outstanding >= SHM_CAPACITY)
+            return false;
+        ShmMessage message;
+        message.slot = (uint16_t)slot;
+        message.tag = tag;
+        message.length = (uint32_t)length;
+        memcpy(message.data, line, length);
+
+        MpscQueue& queue = Queue();
+        if (!queue.TryPush(message))
+            return false;
+        ++outstanding;
+        if (ring)
+            queue.bell.Ring();
+        return true;
+    }
+
+    // Acorda o worker depois de um lote enviado com ring = false.
+    void Notify() { Queue().bell.Ring(); }
+
+    bool TryReceive(ShmMessage& message)
+    {
+        if (!segment->responses[slot].TryPop(message))
+            return false;
+        if (outstanding > 0)
+            --outstanding;
+        return true;
+    }
+
+    bool WaitResponse(int64_t timeoutNs)
+    {
+        SpscRing& ring = segment->responses[slot];
+        return waiter.Wait(ring.bell, [&ring] { return !ring.Empty(); }, timeoutNs);
+    }
+
+private:
+    ShmSegment* segment = nullptr;
+    int slot = -1;
+    uint32_t outstanding = 0; // requisições publicadas ainda sem resposta
+    AdaptiveWaiter waiter;
+
+    MpscQueue& Queue() { return segment->requests[slot % segment->queueCount]; }
+};